@@ -0,0 +1,75 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_ALIGNED_ARRAY_H_
+#define SRC_ALIGNED_ARRAY_H_
+
+#include <cstdlib>
+#include <cstring>
+
+namespace computer_animation {
+
+//! \brief The size of a cache line, in bytes.
+const int kCacheLineSize = 64;
+
+//! \class AlignedArray
+//! \brief A heap array whose storage starts on a cache line boundary.
+//!
+//! Used for buffers that are read or written with SIMD instructions, or
+//! split between threads. Elements must be plain data; they are zeroed when
+//! the array is resized, not constructed.
+template <typename T> class AlignedArray {
+  public:
+    AlignedArray() : data_(NULL), size_(0) {
+    }
+
+    ~AlignedArray() {
+      free(data_);
+    }
+
+    //! \brief Resizes the array to hold size elements, all set to zero.
+    //!
+    //! Any existing contents are discarded.
+    void Resize(int size) {
+      free(data_);
+      data_ = NULL;
+      size_ = size;
+
+      // Round up so that there is always at least one cache line.
+      size_t bytes = (size * sizeof(T) + kCacheLineSize - 1) /
+          kCacheLineSize * kCacheLineSize;
+      if (bytes == 0) {
+        bytes = kCacheLineSize;
+      }
+      void* memory = NULL;
+      if (posix_memalign(&memory, kCacheLineSize, bytes) == 0) {
+        memset(memory, 0, bytes);
+        data_ = static_cast<T*>(memory);
+      }
+    }
+
+    //! \brief Returns the number of elements in the array.
+    inline int size() const { return size_; }
+
+    //! \brief Returns a pointer to the first element.
+    inline T* data() { return data_; }
+
+    //! \brief Returns a pointer to the first element.
+    inline const T* data() const { return data_; }
+
+    //! \brief Returns the i-th element. Does not perform bounds checking.
+    inline T& operator[] (int i) { return data_[i]; }
+
+    //! \brief Returns the i-th element. Does not perform bounds checking.
+    inline const T& operator[] (int i) const { return data_[i]; }
+
+  private:
+    // Copying is not allowed.
+    AlignedArray(const AlignedArray&);
+    AlignedArray& operator=(const AlignedArray&);
+
+    T* data_;
+    int size_;
+};
+}
+
+#endif  // SRC_ALIGNED_ARRAY_H_
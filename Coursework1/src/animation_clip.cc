@@ -0,0 +1,325 @@
+//! \author Stephen McGruer
+
+#include "./animation_clip.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "./aligned_array.h"
+
+namespace computer_animation {
+
+namespace {
+
+// The number of sections in an animation clip file.
+const int kNumClipSections = 3;
+
+// The furthest a dropped key may be from the line between the keys kept
+// either side of it, with a tolerance of 0, in degrees. This only allows
+// for rounding in the slope calculations.
+const double kMinimumTolerance = 1e-3;
+
+// Chooses which of a track's keys to keep. values[k] is the track's value
+// at times[k] milliseconds. The first and last keys are always kept; a key
+// between them is dropped if it lies within tolerance degrees of the line
+// between the kept keys either side.
+//
+// Each kept key is the anchor of a run of keys, which is extended while
+// some line from the anchor passes within tolerance of every key it
+// drops. Every dropped key narrows the range of slopes that such a line
+// can have, so each key is only looked at once.
+void ReduceKeys(const std::vector<uint32_t> &times,
+    const std::vector<int> &values, double tolerance,
+    std::vector<int> *kept) {
+  int num_keys = times.size();
+  kept->assign(1, 0);
+  int anchor = 0;
+  double min_slope = -DBL_MAX;
+  double max_slope = DBL_MAX;
+  for (int k = 1; k < num_keys; k++) {
+    int candidate = k - 1;
+    if (candidate == anchor) {
+      continue;
+    }
+
+    // Try to drop the previous key, so that the anchor's run ends at k.
+    double candidate_time = static_cast<double>(times[candidate]) -
+        times[anchor];
+    double time = static_cast<double>(times[k]) - times[anchor];
+    bool drop = candidate_time > 0.0;
+    if (drop) {
+      double offset = values[candidate] - values[anchor];
+      min_slope = std::max(min_slope, (offset - tolerance) / candidate_time);
+      max_slope = std::min(max_slope, (offset + tolerance) / candidate_time);
+      double slope = (values[k] - values[anchor]) / time;
+      drop = min_slope <= slope && slope <= max_slope;
+    }
+    if (!drop) {
+      kept->push_back(candidate);
+      anchor = candidate;
+      min_slope = -DBL_MAX;
+      max_slope = DBL_MAX;
+    }
+  }
+  if (num_keys > 1) {
+    kept->push_back(num_keys - 1);
+  }
+}
+}  // namespace
+
+AnimationClip::AnimationClip()
+    : num_keyframes_(0),
+      duration_ms_(0) {
+}
+
+void AnimationClip::Build(const std::vector<float> &key_times,
+    const std::vector<Vector3d<int> > &key_rotations, int num_bones,
+    float tolerance) {
+  int num_keyframes = key_times.size();
+  int num_tracks = 3 * num_bones;
+  double track_tolerance = std::max(static_cast<double>(tolerance),
+      kMinimumTolerance);
+
+  std::vector<uint32_t> times(num_keyframes);
+  for (int k = 0; k < num_keyframes; k++) {
+    times[k] = static_cast<uint32_t>(std::floor(key_times[k] * 1000.0 + 0.5));
+  }
+
+  std::vector<ClipTrack> tracks(num_tracks);
+  std::vector<uint32_t> clip_times;
+  std::vector<int16_t> clip_values;
+  std::vector<int> values(num_keyframes);
+  std::vector<int> kept;
+  for (int track = 0; track < num_tracks; track++) {
+    int bone = track / 3;
+    int axis = track % 3;
+    bool constant = true;
+    for (int k = 0; k < num_keyframes; k++) {
+      values[k] = key_rotations[k * num_bones + bone][axis];
+      constant = constant && values[k] == values[0];
+    }
+
+    ClipTrack &clip_track = tracks[track];
+    clip_track.first_key = clip_times.size();
+    clip_track.num_keys = 0;
+    clip_track.value = num_keyframes > 0 ? values[0] : 0;
+    if (constant) {
+      continue;
+    }
+
+    ReduceKeys(times, values, track_tolerance, &kept);
+    for (size_t i = 0; i < kept.size(); i++) {
+      clip_times.push_back(times[kept[i]]);
+      clip_values.push_back(values[kept[i]]);
+    }
+    clip_track.num_keys = kept.size();
+  }
+
+  tracks_.Assign(&tracks);
+  key_times_.Assign(&clip_times);
+  key_values_.Assign(&clip_values);
+  num_keyframes_ = num_keyframes;
+  duration_ms_ = num_keyframes > 0 ? times[num_keyframes - 1] : 0;
+  cursors_.assign(num_tracks, 0);
+  file_.Close();
+}
+
+bool AnimationClip::Load(const char *filename, int num_bones) {
+  MappedFile file;
+  if (!file.Open(filename) || file.size() < sizeof(AnimationClipHeader)) {
+    return false;
+  }
+
+  AnimationClipHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, "CAVA", 4) != 0 ||
+      header.version != kAnimationClipVersion ||
+      header.file_size != file.size() ||
+      header.num_bones != static_cast<uint32_t>(num_bones) ||
+      header.num_tracks != 3 * header.num_bones) {
+    return false;
+  }
+
+  // Check that every section lies within the file and is aligned.
+  const uint64_t offsets[] = {header.tracks_offset, header.key_times_offset,
+      header.key_values_offset};
+  const uint64_t sizes[] = {
+      header.num_tracks * sizeof(ClipTrack),
+      header.num_keys * sizeof(uint32_t),
+      header.num_keys * sizeof(int16_t)};
+  for (int i = 0; i < kNumClipSections; i++) {
+    if (offsets[i] % kCacheLineSize != 0 || offsets[i] > file.size() ||
+        sizes[i] > file.size() - offsets[i]) {
+      return false;
+    }
+  }
+
+  // Check that every track's keys are in the file and in time order, so
+  // that sampling can trust them.
+  const char* data = file.data();
+  const ClipTrack* tracks =
+      reinterpret_cast<const ClipTrack*>(data + header.tracks_offset);
+  const uint32_t* times =
+      reinterpret_cast<const uint32_t*>(data + header.key_times_offset);
+  for (uint32_t track = 0; track < header.num_tracks; track++) {
+    uint32_t first = tracks[track].first_key;
+    uint32_t count = tracks[track].num_keys;
+    if (first > header.num_keys || count > header.num_keys - first) {
+      return false;
+    }
+    for (uint32_t k = first + 1; k < first + count; k++) {
+      if (times[k] < times[k - 1]) {
+        return false;
+      }
+    }
+  }
+
+  tracks_.Borrow(tracks, header.num_tracks);
+  key_times_.Borrow(times, header.num_keys);
+  key_values_.Borrow(reinterpret_cast<const int16_t*>(
+      data + header.key_values_offset), header.num_keys);
+  num_keyframes_ = header.num_keyframes;
+  duration_ms_ = header.duration_ms;
+  cursors_.assign(header.num_tracks, 0);
+
+  // Keep the file mapped for as long as the arrays refer to it.
+  file_.Swap(&file);
+  return true;
+}
+
+bool AnimationClip::Write(const char *filename) const {
+  AnimationClipHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "CAVA", 4);
+  header.version = kAnimationClipVersion;
+  header.num_bones = tracks_.size() / 3;
+  header.num_tracks = tracks_.size();
+  header.num_keys = key_times_.size();
+  header.num_keyframes = num_keyframes_;
+  header.duration_ms = duration_ms_;
+
+  // Lay the sections out one after another, each on a cache line boundary.
+  const void* sections[] = {tracks_.data(), key_times_.data(),
+      key_values_.data()};
+  const size_t sizes[] = {
+      tracks_.size() * sizeof(ClipTrack),
+      key_times_.size() * sizeof(uint32_t),
+      key_values_.size() * sizeof(int16_t)};
+  uint64_t* offsets[] = {&header.tracks_offset, &header.key_times_offset,
+      &header.key_values_offset};
+
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < kNumClipSections; i++) {
+    offset = (offset + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+    *offsets[i] = offset;
+    offset += sizes[i];
+  }
+  header.file_size = offset;
+
+  // Write to a temporary file and rename it into place, so that a reader
+  // never sees a partly written clip.
+  std::string temporary_filename = std::string(filename) + ".tmp";
+  FILE *f = fopen(temporary_filename.c_str(), "wb");
+  if (f == NULL) {
+    return false;
+  }
+
+  static const char kZeroes[kCacheLineSize] = {0};
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  uint64_t written = sizeof(header);
+  for (int i = 0; i < kNumClipSections && ok; i++) {
+    ok = fwrite(kZeroes, 1, *offsets[i] - written, f) == *offsets[i] - written
+        && fwrite(sections[i], 1, sizes[i], f) == sizes[i];
+    written = *offsets[i] + sizes[i];
+  }
+
+  if (fclose(f) != 0 || !ok ||
+      rename(temporary_filename.c_str(), filename) != 0) {
+    remove(temporary_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool AnimationClip::IsClipFile(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  char magic[4];
+  bool is_clip = fread(magic, 1, 4, f) == 4 && memcmp(magic, "CAVA", 4) == 0;
+  fclose(f);
+  return is_clip;
+}
+
+int AnimationClip::SampleTrack(int track, float time_ms) {
+  const ClipTrack &clip_track = tracks_[track];
+  if (clip_track.num_keys == 0) {
+    return clip_track.value;
+  }
+
+  const uint32_t* times = key_times_.data() + clip_track.first_key;
+  const int16_t* values = key_values_.data() + clip_track.first_key;
+  uint32_t last = clip_track.num_keys - 1;
+  if (time_ms <= times[0]) {
+    return values[0];
+  } else if (time_ms >= times[last]) {
+    return values[last];
+  }
+
+  // The time is now strictly between the first and last keys.
+  uint32_t &key = cursors_[track];
+  if (key < last && times[key] <= time_ms && time_ms < times[key + 1]) {
+    // Still between the same keys.
+  } else if (key + 1 < last && times[key + 1] <= time_ms &&
+             time_ms < times[key + 2]) {
+    // Moved on to the next pair of keys, as in normal playback.
+    key++;
+  } else {
+    key = std::upper_bound(times, times + last, time_ms) - times - 1;
+  }
+
+  float alpha = (time_ms - times[key]) / (times[key + 1] - times[key]);
+  int from = values[key];
+  return from + static_cast<int>(
+      std::floor((values[key + 1] - from) * alpha + 0.5f));
+}
+
+void AnimationClip::Sample(float t, Skeleton *skeleton) {
+  if (tracks_.empty()) {
+    return;
+  }
+
+  // Only the bones that both the clip and the skeleton have are posed.
+  float time_ms = t * 1000.0f;
+  int num_bones = tracks_.size() / 3;
+  if (num_bones > skeleton->GetNumberBones()) {
+    num_bones = skeleton->GetNumberBones();
+  }
+  for (int b = 0; b < num_bones; b++) {
+    Vector3d<int> rotation(SampleTrack(3 * b, time_ms),
+        SampleTrack(3 * b + 1, time_ms), SampleTrack(3 * b + 2, time_ms));
+    skeleton->SetRotation(b, rotation);
+    skeleton->SetPosition(b, skeleton->RestPosition(b));
+  }
+}
+
+int AnimationClip::NumberConstantTracks() const {
+  int count = 0;
+  for (size_t i = 0; i < tracks_.size(); i++) {
+    if (tracks_[i].num_keys == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t AnimationClip::SizeInBytes() const {
+  return tracks_.size() * sizeof(ClipTrack) +
+      key_times_.size() * (sizeof(uint32_t) + sizeof(int16_t));
+}
+}
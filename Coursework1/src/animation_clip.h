@@ -0,0 +1,152 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_ANIMATION_CLIP_H_
+#define SRC_ANIMATION_CLIP_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./mesh_array.h"
+#include "./skeleton.h"
+
+namespace computer_animation {
+
+//! \struct AnimationClipHeader
+//! \brief The header at the start of an animation clip file.
+//!
+//! A clip stores one track per bone and axis. A track that never changes
+//! is stored as just its value. Otherwise it is a list of keys, each a
+//! time in milliseconds and a rotation in whole degrees, and the rotation
+//! between two keys is found by linear interpolation. Keys that the
+//! interpolation would reproduce closely enough are left out when the clip
+//! is built.
+//!
+//! The sections follow the header, each on a cache line boundary so that
+//! the file can be mapped and used in place:
+//!   tracks       num_tracks ClipTracks, bone 0's x, y and z first.
+//!   key times    num_keys uint32_t millisecond times.
+//!   key values   num_keys int16_t rotations.
+//! All values are stored in the machine's native byte order.
+struct AnimationClipHeader {
+  char magic[4];  // Always "CAVA".
+  uint32_t version;
+
+  // The size of the whole file, in bytes.
+  uint64_t file_size;
+
+  uint32_t num_bones;
+  uint32_t num_tracks;
+  uint32_t num_keys;
+
+  // The number of keyframes the clip was built from, and its length.
+  uint32_t num_keyframes;
+  uint32_t duration_ms;
+
+  // Byte offsets of the sections from the start of the file.
+  uint64_t tracks_offset;
+  uint64_t key_times_offset;
+  uint64_t key_values_offset;
+};
+
+//! \brief The current animation clip version.
+const uint32_t kAnimationClipVersion = 1;
+
+//! \struct ClipTrack
+//! \brief The keys of one rotation axis of one bone.
+//!
+//! The track's keys are [first_key, first_key + num_keys) of the clip's
+//! key arrays. A track with no keys always has the given value.
+struct ClipTrack {
+  uint32_t first_key;
+  uint32_t num_keys;
+  int32_t value;
+};
+
+//! \class AnimationClip
+//! \brief A compressed animation, which can be sampled at any time.
+//!
+//! Each track remembers which of its keys it last sampled from, so
+//! playing a clip forwards finds every key in constant time. Jumps find
+//! the keys by binary search.
+class AnimationClip {
+  public:
+    AnimationClip();
+
+    //! \brief Builds the clip from a list of keyframes.
+    //!
+    //! key_times holds the time of each keyframe in seconds, in increasing
+    //! order, and key_rotations the rotation of each of num_bones bones at
+    //! each keyframe. Keys are dropped where interpolating between the
+    //! keys either side comes within tolerance degrees of them; with a
+    //! tolerance of 0, only keys that interpolation reproduces exactly are
+    //! dropped, so the clip plays back exactly as the keyframes do.
+    void Build(const std::vector<float> &key_times,
+        const std::vector<Vector3d<int> > &key_rotations, int num_bones,
+        float tolerance);
+
+    //! \brief Maps a clip file and uses it in place.
+    //!
+    //! Returns false if the file cannot be read or is not a valid clip for
+    //! a skeleton of num_bones bones.
+    bool Load(const char *filename, int num_bones);
+
+    //! \brief Writes the clip to a file. Returns false on failure.
+    bool Write(const char *filename) const;
+
+    //! \brief Returns true if the named file starts like a clip file.
+    static bool IsClipFile(const char *filename);
+
+    //! \brief Poses a skeleton as it is at t seconds into the clip.
+    //!
+    //! Rotations are rounded to the nearest degree, and bones are moved
+    //! back to their rest positions. Times outside the clip give its first
+    //! or last pose.
+    void Sample(float t, Skeleton *skeleton);
+
+    //! \brief Returns the length of the clip in seconds.
+    inline float duration() const { return duration_ms_ / 1000.0f; }
+
+    //! \brief Returns the number of keyframes the clip was built from.
+    inline int num_keyframes() const { return num_keyframes_; }
+
+    //! \brief Returns the number of keys stored, over all tracks.
+    inline int num_keys() const { return key_times_.size(); }
+
+    //! \brief Returns the number of tracks, which is three per bone.
+    inline int num_tracks() const { return tracks_.size(); }
+
+    //! \brief Returns the number of tracks stored as a single value.
+    int NumberConstantTracks() const;
+
+    //! \brief Returns the size of the clip's data, in bytes, as stored in
+    //! memory or in a file (less the header and padding).
+    size_t SizeInBytes() const;
+
+    //! \brief Returns true if a clip has been built or loaded.
+    inline bool empty() const { return tracks_.empty(); }
+
+  private:
+    // Copying is not allowed.
+    AnimationClip(const AnimationClip&);
+    AnimationClip& operator=(const AnimationClip&);
+
+    // Returns the rotation of a track at time_ms milliseconds.
+    int SampleTrack(int track, float time_ms);
+
+    MeshArray<ClipTrack> tracks_;
+    MeshArray<uint32_t> key_times_;
+    MeshArray<int16_t> key_values_;
+    int num_keyframes_;
+    uint32_t duration_ms_;
+
+    // The key at or before the last time sampled, for each track.
+    std::vector<uint32_t> cursors_;
+
+    // The clip file, when the clip was loaded from one.
+    MappedFile file_;
+};
+}
+
+#endif  // SRC_ANIMATION_CLIP_H_
@@ -3,11 +3,33 @@
 #include "./animation_controller.h"
 
 #include <cstdio>
-#include <cstring>
+#include <vector>
 
 namespace computer_animation {
 
+AnimationController::AnimationController() {
+}
+
+void AnimationController::SetSkeleton(const Skeleton &skeleton) {
+  pose_ = skeleton;
+  pose_.Reset();
+}
+
 void AnimationController::LoadAnimation(const char* filename) {
+  LoadAnimation(filename, 0.0f);
+}
+
+void AnimationController::LoadAnimation(const char* filename,
+    float tolerance) {
+  int num_bones = pose_.GetNumberBones();
+  if (AnimationClip::IsClipFile(filename)) {
+    if (!clip_.Load(filename, num_bones)) {
+      fprintf(stderr, "Error: Failed reading animation clip %s\n",
+          filename);
+    }
+    return;
+  }
+
   FILE *f;
   f = fopen(filename, "r");
 
@@ -22,59 +44,60 @@ void AnimationController::LoadAnimation(const char* filename) {
   int bone;
   int rx, ry, rz;
 
-  std::vector<Skeleton> keyframes;
-  std::vector<float> times;
-  Skeleton skeleton;
+  // The time of each keyframe from the start of the animation, and the
+  // rotation of every bone at each keyframe.
+  std::vector<float> key_times(1, 0.0f);
+  std::vector<Vector3d<int> > key_rotations(num_bones,
+      Vector3d<int>(0, 0, 0));
   while (fgets(buf, sizeof(buf), f) != NULL) {
     if (buf[0] == 't') {
       // This is safe as buf is a bounded-size input.
       sscanf(buf, "%s %f", header, &time);
-      times.push_back(time);
 
-      // New frame.
-      keyframes.push_back(skeleton);
-      skeleton = Skeleton();
+      // New keyframe, which starts at the rest position.
+      key_times.push_back(key_times.back() + time);
+      key_rotations.resize(key_rotations.size() + num_bones,
+          Vector3d<int>(0, 0, 0));
     } else {
       // New bone.
 
       // This is safe as buf is a bounded-size input.
-      sscanf(buf, "%d %d %d %d", &bone, &rx, &ry, &rz);
+      if (sscanf(buf, "%d %d %d %d", &bone, &rx, &ry, &rz) != 4) {
+        continue;
+      }
+      if (bone < 0 || bone >= num_bones) {
+        fprintf(stderr, "Warning: Ignoring unknown bone %d in animation "
+            "file %s\n", bone, filename);
+        continue;
+      }
 
-      skeleton.AdjustBoneRotation(bone, Vector3d<int>(rx, ry, rz));
+      // Accumulate the rotation as Skeleton::AdjustBoneRotation does.
+      Vector3d<int> &rotation =
+          key_rotations[key_rotations.size() - num_bones + bone];
+      rotation += Vector3d<int>(rx, ry, rz);
+      for (int c = 0; c < 3; c++) {
+        rotation[c] %= 360;
+      }
     }
   }
-  keyframes.push_back(skeleton);
   fclose(f);
 
-  // Now calculate the frames from the keyframes, using linear interpolation.
-  animation_.clear();
-  for (unsigned int i = 0; i < times.size(); i++) {
-    // Calculate the difference between the frames.
-    Skeleton difference = keyframes.at(i + 1) - keyframes.at(i);
-
-    // Keyframes i and i+1 are linked by (time_between_keyframes *
-    // frames_per_second) normal frames.
-    int num_frames = times.at(i) * kFps;
-
-    // Scale the difference by the number of frames.
-    int num_bones = difference.GetNumberBones();
-    for (int bone = 0; bone < num_bones; bone++) {
-      Vector3d<int> rotation = difference.GetBone(bone).Rotation();
-      rotation /= num_frames;
-      difference.GetBone(bone).SetRotation(rotation);
-    }
+  clip_.Build(key_times, key_rotations, num_bones, tolerance);
+}
 
-    // Add the frames to the animation.
-    for (int frame = 0; frame < num_frames; frame++) {
-      Skeleton tmp = keyframes.at(i);
-      for (int bone = 0; bone < num_bones; bone++) {
-        Vector3d<int> rotation_delta = difference.GetBone(bone).Rotation();
-        rotation_delta *= (frame + 1);
+void AnimationController::Sample(float t, Skeleton *skeleton) {
+  clip_.Sample(t, skeleton);
+}
 
-        tmp.AdjustBoneRotation(bone, rotation_delta);
-      }
-      animation_.push_back(tmp);
-    }
+const Skeleton& AnimationController::Sample(float t) {
+  Sample(t, &pose_);
+  return pose_;
+}
+
+int AnimationController::NumberFrames() const {
+  if (clip_.empty()) {
+    return 0;
   }
+  return static_cast<int>(duration() * kFps) + 1;
 }
 }
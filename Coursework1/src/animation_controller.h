@@ -3,8 +3,7 @@
 #ifndef SRC_ANIMATION_CONTROLLER_H_
 #define SRC_ANIMATION_CONTROLLER_H_
 
-#include <vector>
-
+#include "./animation_clip.h"
 #include "./skeleton.h"
 
 namespace computer_animation {
@@ -16,17 +15,20 @@ const int kFps = 25;
 const int kMillisecondsPerFrame = 1000 / kFps;
 
 //! \class AnimationController
-//! \brief Loads animations from files and allows access to their frames.
+//! \brief Loads animations from files and poses skeletons from them.
 //!
-//! Animations are converted from a set of keyframes to a set of individual
-//! frames, which can then be accessed by calling Frame(int i).
+//! Animations are stored as an AnimationClip, which keeps only the keys
+//! needed to rebuild each bone's rotations. Poses between the keys are
+//! interpolated when they are asked for with Sample(), so an animation can
+//! be played at any rate, and sampling times in order costs the same
+//! however long the animation is.
 class AnimationController {
   public:
+    AnimationController();
+
     //! \brief Loads in an animation from a file.
     //!
-    //! The animation is converted from a set of keyframes stored in a file
-    //! to a full set of kFps frames per second. Each keyframe in the file
-    //! is a set of line which conform to:
+    //! Each keyframe in the file is a set of lines which conform to:
     //!
     //! [bone_number] [rot_x] [rot_y] [rot_z]
     //!
@@ -37,16 +39,69 @@ class AnimationController {
     //!
     //! Only bones that are different from the rest position need to be
     //! specified in a keyframe. An empty keyframe is just the rest position.
+    //!
+    //! The file may instead be an animation clip file, written by
+    //! AnimationClip::Write(), which is mapped and used in place.
     void LoadAnimation(const char* filename);
 
-    //! \brief Returns the i-th frame of the current animation.
-    inline Skeleton Frame(int i) const { return animation_.at(i); }
+    //! \brief Loads in an animation from a file, dropping keyframes that
+    //! interpolation reproduces to within tolerance degrees.
+    //!
+    //! The tolerance only applies to text files; clip files are used as
+    //! they were written.
+    void LoadAnimation(const char* filename, float tolerance);
 
-    //! \brief Returns the number of frames in the current animation.
-    inline int NumberFrames() const { return animation_.size(); }
+    //! \brief Poses a skeleton as it is at t seconds into the animation.
+    //!
+    //! Each bone's rotation is linearly interpolated between the keys
+    //! either side of t, and rounded to the nearest degree. Bones are moved
+    //! back to their rest positions. Times before the start or after the
+    //! end give the first or last keyframe.
+    void Sample(float t, Skeleton *skeleton);
+
+    //! \brief Returns the pose t seconds into the animation.
+    //!
+    //! The pose is stored in the controller, so is only valid until the
+    //! next call to Sample() or Frame().
+    const Skeleton& Sample(float t);
+
+    //! \brief Returns the i-th frame of the animation, played at kFps
+    //! frames per second.
+    inline const Skeleton& Frame(int i) {
+      return Sample(static_cast<float>(i) / kFps);
+    }
+
+    //! \brief Returns the number of frames in the animation when played at
+    //! kFps frames per second, counting both the first and last keyframes.
+    //!
+    //! Returns 0 if no animation is loaded.
+    int NumberFrames() const;
+
+    //! \brief Returns the length of the animation in seconds.
+    inline float duration() const { return clip_.duration(); }
+
+    //! \brief Returns the number of keyframes in the animation.
+    inline int NumberKeyframes() const { return clip_.num_keyframes(); }
+
+    //! \brief Sets the skeleton that animations are loaded for.
+    //!
+    //! Animations loaded afterwards give rotations for its bones. Until
+    //! this is called there are no bones, so it must be called before an
+    //! animation is loaded.
+    void SetSkeleton(const Skeleton &skeleton);
+
+    //! \brief Returns the loaded animation.
+    inline const AnimationClip& clip() const { return clip_; }
 
   private:
-    std::vector<Skeleton> animation_;
+    // Copying is not allowed.
+    AnimationController(const AnimationController&);
+    AnimationController& operator=(const AnimationController&);
+
+    AnimationClip clip_;
+
+    // The pose returned by Sample(float).
+    Skeleton pose_;
 };
 }
 
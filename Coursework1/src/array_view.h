@@ -0,0 +1,43 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_ARRAY_VIEW_H_
+#define SRC_ARRAY_VIEW_H_
+
+#include <cstddef>
+
+namespace computer_animation {
+
+//! \class ArrayView
+//! \brief A read-only view of a contiguous run of elements stored
+//! elsewhere.
+//!
+//! Views are as cheap to pass around as a pointer, and never copy the
+//! elements. A view is only valid for as long as the storage it refers to
+//! is not changed or freed.
+template <typename T> class ArrayView {
+  public:
+    ArrayView() : data_(NULL), size_(0) {
+    }
+
+    ArrayView(const T* data, size_t size) : data_(data), size_(size) {
+    }
+
+    //! \brief Returns the number of elements in the view.
+    inline size_t size() const { return size_; }
+
+    //! \brief Returns true if the view has no elements.
+    inline bool empty() const { return size_ == 0; }
+
+    //! \brief Returns a pointer to the first element.
+    inline const T* data() const { return data_; }
+
+    //! \brief Returns the i-th element. Does not perform bounds checking.
+    inline const T& operator[] (size_t i) const { return data_[i]; }
+
+  private:
+    const T* data_;
+    size_t size_;
+};
+}
+
+#endif  // SRC_ARRAY_VIEW_H_
@@ -0,0 +1,1058 @@
+//! \author Stephen McGruer
+
+// A command line tool for skinning meshes without opening a window, for
+// generating vertex caches offline and for measuring performance.
+//
+// Usage:
+//
+//   cav_batch skin <object> <weights> <animation> <output> [-threads n]
+//       [-normals] [-optimize] [-lod-budget vertices] [-skeleton file]
+//   cav_batch optimize <object> <weights>
+//   cav_batch lod <object> <weights> <animation> [-levels n]
+//       [-reduction fraction] [-threads n] [-skeleton file]
+//   cav_batch bench-load [directory]
+//   cav_batch compress-anim <animation> <output> [-tolerance degrees]
+//       [-skeleton file]
+//   cav_batch crowd <object> <weights> <animation> [-max-instances n]
+//       [-threads n] [-skeleton file]
+//   cav_batch ik <animation> [-method ccd|fabrik] [-iterations n]
+//       [-tolerance distance] [-characters n] [-skeleton file]
+//   cav_batch bake <object> <weights> <animation> <output> [-optimize]
+//       [-skeleton file] [-key-interval frames] [-threads n]
+//
+// Every command that poses a skeleton loads it from skeleton2.out, or from
+// the file given with -skeleton, and checks that it has every bone that
+// the weights use.
+//
+// "skin" skins every frame of an animation and writes the skinned vertex
+// positions to <output> as a vertex stream. A vertex stream is a
+// VertexStreamHeader followed by num_frames frames, each of which is
+// num_vertices (x, y, z) triples of 32-bit floats. All values are stored
+// in the machine's native byte order. With -normals, the vertex normals are
+// also recomputed every frame (and included in the timing), but are not
+// written out. With -optimize, the mesh's vertex order is optimized first
+// (see TriangleMesh::OptimizeVertexOrder), so the vertices are written in
+// the optimized order. With -lod-budget, the most detailed level of detail
+// (see LodChain) with at most the given number of vertices is skinned and
+// written instead of the full mesh.
+//
+// "optimize" reorders a mesh for the vertex cache and reports the ACMR
+// (average cache miss ratio) before and after, and how long it took.
+//
+// "lod" builds a chain of levels of detail for a mesh and reports, for each
+// level, its size, its estimated error, and how long it takes to skin every
+// frame of an animation.
+//
+// "bench-load" measures how long TriangleMesh::LoadFile takes on a series
+// of generated grid meshes of increasing size, and how much memory their
+// triangles and edges take compared with the old layout, where each Edge
+// kept its triangles in a std::set. The old layout is built for each mesh
+// and its size measured by counting what its containers allocate, which
+// leaves out malloc's own overhead per allocation (so understates the
+// old layout's size). The meshes are written to temporary files in
+// [directory] (/tmp by default) and removed afterwards.
+//
+// "compress-anim" converts a text animation to an animation clip file (see
+// AnimationClip), which the viewer and the other commands can load in its
+// place. With -tolerance, keys that interpolation reproduces to within the
+// given number of degrees are dropped; by default only keys it reproduces
+// exactly are. It reports the size of the clip against the text file and
+// the keyframes it was built from, the largest difference from the exact
+// animation at any frame, and how long a pose takes to sample.
+//
+// "crowd" skins growing crowds of instances of a mesh, from 1 up to
+// -max-instances (1000 by default), each playing the animation from a
+// different point. For each size it reports how long posing the instances
+// and skinning them all in one batch (see SkinningEngine::SkinInstances)
+// take per frame, against skinning the instances one at a time.
+//
+// "ik" plays the animation on -characters characters (100 by default),
+// each from a different point, and every frame pulls each character's feet
+// and hands back to where they are in the rest pose with an IkSolver, as
+// if they were planted. It reports how many iterations and how long each
+// solve took, how many converged, and the time per frame for all of the
+// characters.
+//
+// "bake" skins every frame of an animation, with normals, and writes them
+// to <output> as a vertex cache (see VertexCache), which the viewer can
+// play back with -vertex-cache instead of posing and skinning the mesh.
+// A key frame is stored every -key-interval frames (25 by default). It
+// reports the size of the cache against the raw frames, the largest
+// position and normal error, and how long a frame takes to decode
+// against how long it took to skin.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "./animation_clip.h"
+#include "./animation_controller.h"
+#include "./ik_solver.h"
+#include "./lod_chain.h"
+#include "./mesh_cache.h"
+#include "./mesh_optimizer.h"
+#include "./skinning_engine.h"
+#include "./triangle_mesh.h"
+#include "./vertex_cache.h"
+
+namespace ca = computer_animation;
+
+// The header at the start of a vertex stream file.
+struct VertexStreamHeader {
+  char magic[4];  // Always "CAVS".
+  uint32_t version;
+  uint32_t num_vertices;
+  uint32_t num_frames;
+  uint32_t frames_per_second;
+};
+
+const uint32_t kVertexStreamVersion = 1;
+
+// The skeleton that the commands use unless -skeleton is given.
+const char* const kDefaultSkeletonFile = "skeleton2.out";
+
+// The number of bytes currently allocated through CountingAllocators.
+size_t counted_bytes = 0;
+
+// An allocator that keeps count, in counted_bytes, of the memory that the
+// containers using it have asked for.
+template <typename T>
+struct CountingAllocator {
+  typedef T value_type;
+
+  CountingAllocator() {}
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    counted_bytes += n * sizeof(T);
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    counted_bytes -= n * sizeof(T);
+    ::operator delete(p);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) {
+  return false;
+}
+
+// The old layout of the connectivity, for comparison: a Triangle also kept
+// its id and the indices of its three edges, and an Edge kept its
+// triangles in a std::set.
+struct LegacyTriangle {
+  int id;
+  int vertices[3];
+  int normals[3];
+  int edges[3];
+};
+
+struct LegacyEdge {
+  int v1;
+  int v2;
+  std::set<int, std::less<int>, CountingAllocator<int> > triangles;
+};
+
+// Forward declarations.
+int SkinCommand(int argc, char **argv);
+int OptimizeCommand(int argc, char **argv);
+int LodCommand(int argc, char **argv);
+int BenchLoadCommand(int argc, char **argv);
+int CompressAnimationCommand(int argc, char **argv);
+int CrowdCommand(int argc, char **argv);
+int IkCommand(int argc, char **argv);
+int BakeCommand(int argc, char **argv);
+bool WriteGridMesh(const char *filename, int size);
+size_t LegacyConnectivityBytes(const ca::TriangleMesh &model);
+void PrintUsage(const char *program);
+double SecondsSince(std::chrono::steady_clock::time_point start);
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  if (strcmp(argv[1], "skin") == 0) {
+    return SkinCommand(argc, argv);
+  } else if (strcmp(argv[1], "optimize") == 0) {
+    return OptimizeCommand(argc, argv);
+  } else if (strcmp(argv[1], "lod") == 0) {
+    return LodCommand(argc, argv);
+  } else if (strcmp(argv[1], "bench-load") == 0) {
+    return BenchLoadCommand(argc, argv);
+  } else if (strcmp(argv[1], "compress-anim") == 0) {
+    return CompressAnimationCommand(argc, argv);
+  } else if (strcmp(argv[1], "crowd") == 0) {
+    return CrowdCommand(argc, argv);
+  } else if (strcmp(argv[1], "ik") == 0) {
+    return IkCommand(argc, argv);
+  } else if (strcmp(argv[1], "bake") == 0) {
+    return BakeCommand(argc, argv);
+  }
+
+  PrintUsage(argv[0]);
+  return 1;
+}
+
+//! \brief Skins every frame of an animation and writes out the vertices.
+int SkinCommand(int argc, char **argv) {
+  if (argc < 6) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ca::TriangleMesh model;
+  ca::SkinningEngine skinning_engine;
+  ca::AnimationController animation_controller;
+  const char* skeleton_file = kDefaultSkeletonFile;
+  int lod_budget = 0;
+
+  for (int i = 6; i < argc; i++) {
+    if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      skinning_engine.SetNumThreads(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-normals") == 0) {
+      skinning_engine.SetNormalsEnabled(true);
+    } else if (strcmp(argv[i], "-optimize") == 0) {
+      model.SetOptimizeVertexOrder(true);
+    } else if (strcmp(argv[i], "-lod-budget") == 0 && i + 1 < argc) {
+      lod_budget = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::chrono::steady_clock::time_point load_start =
+      std::chrono::steady_clock::now();
+  std::string cache_file = std::string(argv[2]) + ".cache";
+  model.LoadWithCache(argv[2], argv[3], cache_file.c_str());
+  if (!model.LoadSkeleton(skeleton_file)) {
+    return 1;
+  }
+  animation_controller.SetSkeleton(*model.skeleton());
+  animation_controller.LoadAnimation(argv[4]);
+
+  // The skeleton is still posed through the full mesh, as every level of
+  // detail shares it.
+  ca::LodChain lod_chain;
+  const ca::TriangleMesh *skinned_model = &model;
+  if (lod_budget > 0) {
+    lod_chain.Build(model, ca::kDefaultLodLevels, ca::kDefaultLodReduction);
+    skinned_model = &lod_chain.level(
+        lod_chain.SelectByVertexBudget(lod_budget));
+  }
+  skinning_engine.Init(*skinned_model);
+  double load_seconds = SecondsSince(load_start);
+
+  int num_frames = animation_controller.NumberFrames();
+  int num_vertices = skinned_model->GetNumberOfVertices();
+  if (num_frames == 0) {
+    fprintf(stderr, "Error: Animation %s has no frames\n", argv[4]);
+    return 1;
+  }
+
+  FILE *f = fopen(argv[5], "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Error: Failed opening output file %s\n", argv[5]);
+    return 1;
+  }
+
+  VertexStreamHeader header;
+  memcpy(header.magic, "CAVS", 4);
+  header.version = kVertexStreamVersion;
+  header.num_vertices = num_vertices;
+  header.num_frames = num_frames;
+  header.frames_per_second = ca::kFps;
+  if (fwrite(&header, sizeof(header), 1, f) != 1) {
+    fprintf(stderr, "Error: Failed writing output file %s\n", argv[5]);
+    fclose(f);
+    return 1;
+  }
+
+  // Only the skinning itself is timed, not loading the frames or writing
+  // them out.
+  double skin_seconds = 0.0;
+  for (int frame = 0; frame < num_frames; frame++) {
+    model.SetSkeleton(animation_controller.Frame(frame));
+
+    std::chrono::steady_clock::time_point skin_start =
+        std::chrono::steady_clock::now();
+    skinning_engine.Skin(model.skeleton());
+    skin_seconds += SecondsSince(skin_start);
+
+    if (fwrite(skinning_engine.positions(), 3 * sizeof(float), num_vertices,
+            f) != static_cast<size_t>(num_vertices)) {
+      fprintf(stderr, "Error: Failed writing output file %s\n", argv[5]);
+      fclose(f);
+      return 1;
+    }
+  }
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Error: Failed writing output file %s\n", argv[5]);
+    return 1;
+  }
+
+  fprintf(stdout, "Loaded %d vertices, %d frames in %.3f s\n", num_vertices,
+      num_frames, load_seconds);
+  fprintf(stdout, "Skinned %d frames in %.3f s using %d thread(s), "
+      "%s kernel%s\n", num_frames, skin_seconds,
+      skinning_engine.num_threads(), ca::KernelName(skinning_engine.kernel()),
+      skinning_engine.normals_enabled() ? ", with normals" : "");
+  fprintf(stdout, "Throughput: %.1f frames/s, %.3g vertices/s\n",
+      num_frames / skin_seconds,
+      static_cast<double>(num_frames) * num_vertices / skin_seconds);
+
+  return 0;
+}
+
+//! \brief Optimizes a mesh's vertex order and reports the improvement.
+int OptimizeCommand(int argc, char **argv) {
+  if (argc != 4) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ca::TriangleMesh model;
+  model.LoadFile(argv[2]);
+  model.LoadWeights(argv[3]);
+
+  float acmr_before;
+  float acmr_after;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  model.OptimizeVertexOrder(&acmr_before, &acmr_after);
+  double seconds = SecondsSince(start);
+
+  fprintf(stdout, "Optimized %d triangles in %.3f s\n",
+      model.GetNumberOfTriangles(), seconds);
+  fprintf(stdout, "ACMR (%d-entry FIFO cache): %.3f before, %.3f after\n",
+      ca::kVertexCacheSize, acmr_before, acmr_after);
+
+  return 0;
+}
+
+//! \brief Builds levels of detail for a mesh and times skinning each one.
+int LodCommand(int argc, char **argv) {
+  if (argc < 5) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ca::TriangleMesh model;
+  ca::SkinningEngine skinning_engine;
+  ca::AnimationController animation_controller;
+  const char* skeleton_file = kDefaultSkeletonFile;
+  int num_levels = ca::kDefaultLodLevels;
+  float reduction = ca::kDefaultLodReduction;
+
+  for (int i = 5; i < argc; i++) {
+    if (strcmp(argv[i], "-levels") == 0 && i + 1 < argc) {
+      num_levels = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-reduction") == 0 && i + 1 < argc) {
+      reduction = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      skinning_engine.SetNumThreads(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (num_levels < 1 || reduction <= 0.0f || reduction >= 1.0f) {
+    fprintf(stderr, "Error: Need at least one level and a reduction "
+        "between 0 and 1\n");
+    return 1;
+  }
+
+  std::string cache_file = std::string(argv[2]) + ".cache";
+  model.LoadWithCache(argv[2], argv[3], cache_file.c_str());
+  if (!model.LoadSkeleton(skeleton_file)) {
+    return 1;
+  }
+  animation_controller.SetSkeleton(*model.skeleton());
+  animation_controller.LoadAnimation(argv[4]);
+  int num_frames = animation_controller.NumberFrames();
+  if (num_frames == 0) {
+    fprintf(stderr, "Error: Animation %s has no frames\n", argv[4]);
+    return 1;
+  }
+
+  ca::LodChain lod_chain;
+  std::chrono::steady_clock::time_point build_start =
+      std::chrono::steady_clock::now();
+  lod_chain.Build(model, num_levels, reduction);
+  fprintf(stdout, "Built %d levels in %.3f s\n", lod_chain.num_levels(),
+      SecondsSince(build_start));
+
+  fprintf(stdout, "%6s %10s %10s %10s %12s %10s\n", "level", "vertices",
+      "triangles", "error", "ms/frame", "speedup");
+  double base_seconds = 0.0;
+  for (int level = 0; level < lod_chain.num_levels(); level++) {
+    const ca::TriangleMesh &mesh = lod_chain.level(level);
+    skinning_engine.Init(mesh);
+    skinning_engine.SetNormalsEnabled(true);
+
+    double seconds = 0.0;
+    for (int frame = 0; frame < num_frames; frame++) {
+      model.SetSkeleton(animation_controller.Frame(frame));
+      std::chrono::steady_clock::time_point skin_start =
+          std::chrono::steady_clock::now();
+      skinning_engine.Skin(model.skeleton());
+      seconds += SecondsSince(skin_start);
+    }
+    if (level == 0) {
+      base_seconds = seconds;
+    }
+
+    fprintf(stdout, "%6d %10d %10d %10.4f %12.4f %9.2fx\n", level,
+        mesh.GetNumberOfVertices(), mesh.GetNumberOfTriangles(),
+        lod_chain.error(level), 1000.0 * seconds / num_frames,
+        base_seconds / seconds);
+  }
+
+  return 0;
+}
+
+//! \brief Times loading generated meshes of several sizes.
+int BenchLoadCommand(int argc, char **argv) {
+  const char *directory = (argc > 2) ? argv[2] : "/tmp";
+  // Grid sizes; a grid of size n has 2n^2 triangles, so the largest is
+  // just over 500,000 triangles.
+  const int kSizes[] = {32, 64, 128, 256, 512};
+  const int kNumSizes = sizeof(kSizes) / sizeof(kSizes[0]);
+
+  char filename[1024];
+  snprintf(filename, sizeof(filename), "%s/cav_bench_load.obj", directory);
+
+  fprintf(stdout, "%10s %10s %10s %10s %14s %10s %10s %7s\n", "vertices",
+      "triangles", "edges", "seconds", "triangles/s", "old KB", "new KB",
+      "saved");
+  for (int i = 0; i < kNumSizes; i++) {
+    if (!WriteGridMesh(filename, kSizes[i])) {
+      fprintf(stderr, "Error: Failed writing mesh file %s\n", filename);
+      return 1;
+    }
+
+    ca::TriangleMesh model;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    model.LoadFile(filename);
+    double seconds = SecondsSince(start);
+
+    size_t old_bytes = LegacyConnectivityBytes(model);
+    size_t new_bytes = model.GetConnectivityBytes();
+    fprintf(stdout, "%10d %10d %10d %10.3f %14.0f %10zu %10zu %6.1f%%\n",
+        model.GetNumberOfVertices(), model.GetNumberOfTriangles(),
+        model.GetNumberOfEdges(), seconds,
+        model.GetNumberOfTriangles() / seconds, old_bytes / 1024,
+        new_bytes / 1024, 100.0 * (old_bytes - new_bytes) / old_bytes);
+  }
+  remove(filename);
+  fprintf(stdout, "old KB is what the old layout's containers allocated, "
+      "without malloc's overhead per allocation\n");
+
+  return 0;
+}
+
+//! \brief Converts a text animation to an animation clip file.
+int CompressAnimationCommand(int argc, char **argv) {
+  if (argc < 4) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  const char* skeleton_file = kDefaultSkeletonFile;
+  float tolerance = 0.0f;
+  for (int i = 4; i < argc; i++) {
+    if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (tolerance < 0.0f) {
+    fprintf(stderr, "Error: The tolerance cannot be negative\n");
+    return 1;
+  }
+  if (ca::AnimationClip::IsClipFile(argv[2])) {
+    fprintf(stderr, "Error: %s is already an animation clip\n", argv[2]);
+    return 1;
+  }
+
+  // The clip stores rotations for the skeleton's bones, and is only loaded
+  // for a skeleton with the same number.
+  ca::Skeleton skeleton;
+  if (!skeleton.Load(skeleton_file)) {
+    return 1;
+  }
+  ca::AnimationController exact;
+  exact.SetSkeleton(skeleton);
+  exact.LoadAnimation(argv[2]);
+  if (exact.NumberFrames() == 0) {
+    fprintf(stderr, "Error: Animation %s has no frames\n", argv[2]);
+    return 1;
+  }
+
+  ca::AnimationController compressed;
+  compressed.SetSkeleton(skeleton);
+  std::chrono::steady_clock::time_point build_start =
+      std::chrono::steady_clock::now();
+  compressed.LoadAnimation(argv[2], tolerance);
+  double build_seconds = SecondsSince(build_start);
+  const ca::AnimationClip &clip = compressed.clip();
+  if (!clip.Write(argv[3])) {
+    fprintf(stderr, "Error: Failed writing animation clip %s\n", argv[3]);
+    return 1;
+  }
+
+  // Check the clip as it will be used, by loading it back from the file.
+  ca::AnimationController loaded;
+  loaded.SetSkeleton(skeleton);
+  loaded.LoadAnimation(argv[3]);
+  if (loaded.clip().empty()) {
+    return 1;
+  }
+
+  // Compare every frame with the exact animation. Rotations are compared
+  // the short way around the circle, as they are stored modulo 360.
+  int num_frames = exact.NumberFrames();
+  int num_bones = exact.Frame(0).GetNumberBones();
+  int max_error = 0;
+  for (int frame = 0; frame < num_frames; frame++) {
+    const ca::Skeleton &expected = exact.Frame(frame);
+    const ca::Skeleton &actual = loaded.Frame(frame);
+    for (int b = 0; b < num_bones; b++) {
+      for (int c = 0; c < 3; c++) {
+        int error = abs(expected.Rotation(b)[c] - actual.Rotation(b)[c]) %
+            360;
+        max_error = std::max(max_error, std::min(error, 360 - error));
+      }
+    }
+  }
+
+  // Time sampling the poses in order, as the viewer does, and at random.
+  ca::Skeleton pose = skeleton;
+  const int kSamples = 100000;
+  float duration = loaded.duration();
+  std::chrono::steady_clock::time_point sample_start =
+      std::chrono::steady_clock::now();
+  for (int i = 0; i < kSamples; i++) {
+    loaded.Sample(duration * i / kSamples, &pose);
+  }
+  double in_order_seconds = SecondsSince(sample_start);
+  srand(1);
+  sample_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kSamples; i++) {
+    loaded.Sample(duration * rand() / RAND_MAX, &pose);
+  }
+  double random_seconds = SecondsSince(sample_start);
+
+  FILE *f = fopen(argv[2], "rb");
+  long text_bytes = 0;
+  if (f != NULL) {
+    fseek(f, 0, SEEK_END);
+    text_bytes = ftell(f);
+    fclose(f);
+  }
+  size_t keyframe_bytes = clip.num_keyframes() *
+      (sizeof(float) + num_bones * sizeof(ca::Vector3d<int>));
+  size_t full_keys = static_cast<size_t>(clip.num_keyframes()) *
+      (clip.num_tracks() - clip.NumberConstantTracks());
+
+  fprintf(stdout, "Built clip in %.3f s: %d keyframes, %.2f s long\n",
+      build_seconds, clip.num_keyframes(), clip.duration());
+  fprintf(stdout, "Tracks: %d of %d constant\n", clip.NumberConstantTracks(),
+      clip.num_tracks());
+  fprintf(stdout, "Keys: %d of %zu kept (%.1f%%) with a tolerance of %g "
+      "degrees\n", clip.num_keys(), full_keys,
+      full_keys > 0 ? 100.0 * clip.num_keys() / full_keys : 100.0,
+      tolerance);
+  fprintf(stdout, "Size: %ld bytes of text, %zu bytes of keyframes, %zu "
+      "bytes of clip (%.1fx smaller)\n", text_bytes, keyframe_bytes,
+      clip.SizeInBytes(),
+      static_cast<double>(keyframe_bytes) / clip.SizeInBytes());
+  fprintf(stdout, "Largest error over %d frames: %d degrees\n", num_frames,
+      max_error);
+  fprintf(stdout, "Sampling: %.3f us/pose in order, %.3f us/pose at "
+      "random\n", 1e6 * in_order_seconds / kSamples,
+      1e6 * random_seconds / kSamples);
+
+  return 0;
+}
+
+//! \brief Times skinning crowds of instances of a mesh.
+int CrowdCommand(int argc, char **argv) {
+  if (argc < 5) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ca::TriangleMesh model;
+  ca::SkinningEngine skinning_engine;
+  ca::AnimationController animation_controller;
+  const char* skeleton_file = kDefaultSkeletonFile;
+  int max_instances = 1000;
+
+  // Skinning the instances one at a time uses an engine of its own, so
+  // that it does not resize the batch's buffers.
+  ca::SkinningEngine single_engine;
+
+  for (int i = 5; i < argc; i++) {
+    if (strcmp(argv[i], "-max-instances") == 0 && i + 1 < argc) {
+      max_instances = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      skinning_engine.SetNumThreads(atoi(argv[++i]));
+      single_engine.SetNumThreads(skinning_engine.num_threads());
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (max_instances < 1) {
+    fprintf(stderr, "Error: Need at least one instance\n");
+    return 1;
+  }
+
+  std::string cache_file = std::string(argv[2]) + ".cache";
+  model.LoadWithCache(argv[2], argv[3], cache_file.c_str());
+  if (!model.LoadSkeleton(skeleton_file)) {
+    return 1;
+  }
+  animation_controller.SetSkeleton(*model.skeleton());
+  animation_controller.LoadAnimation(argv[4]);
+  if (animation_controller.NumberFrames() == 0) {
+    fprintf(stderr, "Error: Animation %s has no frames\n", argv[4]);
+    return 1;
+  }
+  skinning_engine.Init(model);
+  single_engine.Init(model);
+  float duration = animation_controller.duration();
+  int num_vertices = model.GetNumberOfVertices();
+
+  // Each crowd is timed over enough frames to skin about this many
+  // instances in total.
+  const int kInstanceFrames = 2000;
+  const int kCrowdSizes[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+  const int kNumCrowdSizes = sizeof(kCrowdSizes) / sizeof(kCrowdSizes[0]);
+
+  fprintf(stdout, "Skinning %d vertices per instance on %d threads with "
+      "the %s kernel\n", num_vertices, skinning_engine.num_threads(),
+      ca::KernelName(skinning_engine.kernel()));
+  fprintf(stdout, "%9s %7s %10s %10s %10s %12s %12s %8s\n", "instances",
+      "frames", "pose ms", "batch ms", "single ms", "us/instance",
+      "Mvertices/s", "speedup");
+  for (int c = 0; c < kNumCrowdSizes; c++) {
+    int num_instances = kCrowdSizes[c];
+    if (c > 0 && num_instances > max_instances) {
+      num_instances = max_instances;
+      if (num_instances <= kCrowdSizes[c - 1]) {
+        break;
+      }
+    }
+    int num_frames = std::max(3, kInstanceFrames / num_instances);
+
+    // The crowd is made at its full size, so the pointers to the
+    // skeletons stay valid.
+    std::vector<ca::Skeleton> skeletons(num_instances, *model.skeleton());
+    std::vector<ca::Skeleton*> instances(num_instances);
+    for (int i = 0; i < num_instances; i++) {
+      instances[i] = &skeletons[i];
+    }
+
+    double pose_seconds = 0.0;
+    double batch_seconds = 0.0;
+    double single_seconds = 0.0;
+    for (int frame = 0; frame < num_frames; frame++) {
+      // Spread the instances' playback times over the animation.
+      std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      for (int i = 0; i < num_instances; i++) {
+        float t = static_cast<float>(frame) / ca::kFps +
+            duration * i / num_instances;
+        animation_controller.Sample(fmodf(t, duration), instances[i]);
+      }
+      pose_seconds += SecondsSince(start);
+
+      start = std::chrono::steady_clock::now();
+      skinning_engine.SkinInstances(instances.data(), num_instances);
+      batch_seconds += SecondsSince(start);
+
+      start = std::chrono::steady_clock::now();
+      for (int i = 0; i < num_instances; i++) {
+        single_engine.SkinInstances(&instances[i], 1);
+      }
+      single_seconds += SecondsSince(start);
+    }
+
+    double instance_frames = static_cast<double>(num_instances) * num_frames;
+    fprintf(stdout, "%9d %7d %10.3f %10.3f %10.3f %12.2f %12.1f %7.2fx\n",
+        num_instances, num_frames, 1000.0 * pose_seconds / num_frames,
+        1000.0 * batch_seconds / num_frames,
+        1000.0 * single_seconds / num_frames,
+        1e6 * batch_seconds / instance_frames,
+        instance_frames * num_vertices / batch_seconds / 1e6,
+        single_seconds / batch_seconds);
+  }
+
+  return 0;
+}
+
+//! \brief Times inverse kinematics on a crowd of animated characters.
+int IkCommand(int argc, char **argv) {
+  if (argc < 3) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ca::IkSolver solver;
+  const char* skeleton_file = kDefaultSkeletonFile;
+  int num_characters = 100;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-method") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "ccd") == 0) {
+        solver.SetMethod(ca::kCcdMethod);
+      } else if (strcmp(argv[i], "fabrik") == 0) {
+        solver.SetMethod(ca::kFabrikMethod);
+      } else {
+        fprintf(stderr, "Error: Unknown method %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc) {
+      solver.SetMaxIterations(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc) {
+      solver.SetTolerance(atof(argv[++i]));
+    } else if (strcmp(argv[i], "-characters") == 0 && i + 1 < argc) {
+      num_characters = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (num_characters < 1) {
+    fprintf(stderr, "Error: Need at least one character\n");
+    return 1;
+  }
+
+  ca::Skeleton rest;
+  if (!rest.Load(skeleton_file)) {
+    return 1;
+  }
+  // The feet and hands of the default skeleton, held where they are in the
+  // rest pose.
+  rest.UpdateTransforms();
+  solver.Init(rest);
+  for (int i = 0; i < ca::kNumLimbEndBones; i++) {
+    int effector = solver.AddEffector(ca::kLimbEndBones[i], 0);
+    if (effector < 0) {
+      fprintf(stderr, "Error: Skeleton file %s has no bone %d to use as an "
+          "effector\n", skeleton_file, ca::kLimbEndBones[i]);
+      return 1;
+    }
+    solver.SetTarget(effector,
+        ca::IkSolver::JointPosition(rest, ca::kLimbEndBones[i]));
+  }
+
+  ca::AnimationController animation_controller;
+  animation_controller.SetSkeleton(rest);
+  animation_controller.LoadAnimation(argv[2]);
+  int num_frames = animation_controller.NumberFrames();
+  if (num_frames == 0) {
+    fprintf(stderr, "Error: Animation %s has no frames\n", argv[2]);
+    return 1;
+  }
+  float duration = animation_controller.duration();
+
+  fprintf(stdout, "Solving %d effectors for %d characters over %d frames "
+      "with %s, up to %d iterations, tolerance %g\n", solver.num_effectors(),
+      num_characters, num_frames,
+      solver.method() == ca::kCcdMethod ? "CCD" : "FABRIK",
+      solver.max_iterations(), solver.tolerance());
+
+  std::vector<ca::Skeleton> characters(num_characters, rest);
+  int num_solves = 0;
+  int num_converged = 0;
+  long total_iterations = 0;
+  int max_iterations = 0;
+  double total_seconds = 0.0;
+  double max_seconds = 0.0;
+  double max_frame_seconds = 0.0;
+  double total_error = 0.0;
+  float max_error = 0.0f;
+  for (int frame = 0; frame < num_frames; frame++) {
+    // Spread the characters' playback times over the animation.
+    for (int c = 0; c < num_characters; c++) {
+      float t = static_cast<float>(frame) / ca::kFps +
+          duration * c / num_characters;
+      animation_controller.Sample(fmodf(t, duration), &characters[c]);
+    }
+
+    double frame_seconds = 0.0;
+    for (int c = 0; c < num_characters; c++) {
+      ca::IkResult result = solver.Solve(&characters[c]);
+      num_solves++;
+      num_converged += result.converged ? 1 : 0;
+      total_iterations += result.iterations;
+      max_iterations = std::max(max_iterations, result.iterations);
+      frame_seconds += result.seconds;
+      max_seconds = std::max(max_seconds, result.seconds);
+      total_error += result.error;
+      max_error = std::max(max_error, result.error);
+    }
+    total_seconds += frame_seconds;
+    max_frame_seconds = std::max(max_frame_seconds, frame_seconds);
+  }
+
+  fprintf(stdout, "Converged:      %d of %d solves (%.1f%%)\n",
+      num_converged, num_solves, 100.0 * num_converged / num_solves);
+  fprintf(stdout, "Iterations:     %.2f average, %d worst\n",
+      static_cast<double>(total_iterations) / num_solves, max_iterations);
+  fprintf(stdout, "Error:          %.4f average, %.4f worst\n",
+      total_error / num_solves, max_error);
+  fprintf(stdout, "Time per solve: %.2f us average, %.2f us worst\n",
+      1e6 * total_seconds / num_solves, 1e6 * max_seconds);
+  fprintf(stdout, "Time per frame: %.3f ms average, %.3f ms worst, for %d "
+      "characters\n", 1000.0 * total_seconds / num_frames,
+      1000.0 * max_frame_seconds, num_characters);
+  return 0;
+}
+
+//! \brief Skins every frame of an animation into a vertex cache file.
+int BakeCommand(int argc, char **argv) {
+  if (argc < 6) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ca::TriangleMesh model;
+  ca::SkinningEngine skinning_engine;
+  ca::AnimationController animation_controller;
+  const char* skeleton_file = kDefaultSkeletonFile;
+  int key_frame_interval = ca::kDefaultKeyFrameInterval;
+
+  for (int i = 6; i < argc; i++) {
+    if (strcmp(argv[i], "-optimize") == 0) {
+      model.SetOptimizeVertexOrder(true);
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else if (strcmp(argv[i], "-key-interval") == 0 && i + 1 < argc) {
+      key_frame_interval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      skinning_engine.SetNumThreads(atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (key_frame_interval < 1) {
+    fprintf(stderr, "Error: The key frame interval must be at least 1\n");
+    return 1;
+  }
+
+  std::string cache_file = std::string(argv[2]) + ".cache";
+  model.LoadWithCache(argv[2], argv[3], cache_file.c_str());
+  uint64_t mesh_hash;
+  if (!ca::HashMeshSources(argv[2], argv[3], model.max_influences(),
+          model.optimize_vertex_order(), &mesh_hash)) {
+    fprintf(stderr, "Error: Failed reading mesh files %s and %s\n", argv[2],
+        argv[3]);
+    return 1;
+  }
+  if (!model.LoadSkeleton(skeleton_file)) {
+    return 1;
+  }
+  animation_controller.SetSkeleton(*model.skeleton());
+  animation_controller.LoadAnimation(argv[4]);
+  int num_frames = animation_controller.NumberFrames();
+  if (num_frames == 0) {
+    fprintf(stderr, "Error: Animation %s has no frames\n", argv[4]);
+    return 1;
+  }
+  skinning_engine.Init(model);
+  skinning_engine.SetNormalsEnabled(true);
+
+  int num_vertices = model.GetNumberOfVertices();
+  int frame_size = 3 * num_vertices;
+  std::vector<float> positions(static_cast<size_t>(num_frames) * frame_size);
+  std::vector<float> normals(positions.size());
+  double skin_seconds = 0.0;
+  for (int frame = 0; frame < num_frames; frame++) {
+    model.SetSkeleton(animation_controller.Frame(frame));
+
+    std::chrono::steady_clock::time_point skin_start =
+        std::chrono::steady_clock::now();
+    skinning_engine.Skin(model.skeleton());
+    skin_seconds += SecondsSince(skin_start);
+
+    memcpy(&positions[static_cast<size_t>(frame) * frame_size],
+        skinning_engine.positions(), frame_size * sizeof(float));
+    memcpy(&normals[static_cast<size_t>(frame) * frame_size],
+        skinning_engine.normals(), frame_size * sizeof(float));
+  }
+
+  ca::VertexCache baked;
+  baked.Build(positions, normals, num_vertices, ca::kFps, key_frame_interval,
+      mesh_hash);
+  if (!baked.Write(argv[5])) {
+    fprintf(stderr, "Error: Failed writing vertex cache %s\n", argv[5]);
+    return 1;
+  }
+
+  // Check the cache as it will be played, by loading it back from the file
+  // and decoding every frame in order.
+  ca::VertexCache loaded;
+  if (!loaded.Load(argv[5], mesh_hash, num_vertices)) {
+    fprintf(stderr, "Error: Failed reading back vertex cache %s\n", argv[5]);
+    return 1;
+  }
+  std::vector<float> decoded_positions(frame_size);
+  std::vector<float> decoded_normals(frame_size);
+  double decode_seconds = 0.0;
+  float max_position_error = 0.0f;
+  float max_normal_error = 0.0f;
+  for (int frame = 0; frame < num_frames; frame++) {
+    // Only decoding is timed, as the viewer draws the quantized values as
+    // they are.
+    std::chrono::steady_clock::time_point decode_start =
+        std::chrono::steady_clock::now();
+    bool decoded = loaded.DecodeFrame(frame);
+    decode_seconds += SecondsSince(decode_start);
+    if (!decoded || !loaded.DecodeFrame(frame, decoded_positions.data(),
+            decoded_normals.data())) {
+      fprintf(stderr, "Error: Failed decoding frame %d\n", frame);
+      return 1;
+    }
+
+    size_t offset = static_cast<size_t>(frame) * frame_size;
+    for (int i = 0; i < frame_size; i++) {
+      max_position_error = std::max(max_position_error,
+          fabsf(decoded_positions[i] - positions[offset + i]));
+      max_normal_error = std::max(max_normal_error,
+          fabsf(decoded_normals[i] - normals[offset + i]));
+    }
+  }
+
+  size_t raw_bytes = 2 * positions.size() * sizeof(float);
+  fprintf(stdout, "Baked %d frames of %d vertices, with a key frame every "
+      "%d\n", num_frames, num_vertices, key_frame_interval);
+  fprintf(stdout, "Size:           %zu bytes, against %zu as floats "
+      "(%.1fx smaller)\n", loaded.SizeInBytes(), raw_bytes,
+      static_cast<double>(raw_bytes) / loaded.SizeInBytes());
+  fprintf(stdout, "Largest error:  %g in positions, %g in normals\n",
+      max_position_error, max_normal_error);
+  fprintf(stdout, "Time per frame: %.1f us to decode, against %.1f us to "
+      "skin on %d thread(s)\n", 1e6 * decode_seconds / num_frames,
+      1e6 * skin_seconds / num_frames, skinning_engine.num_threads());
+  return 0;
+}
+
+//! \brief Writes out a flat size-by-size grid of quads, split into
+//! triangles, as an object file.
+bool WriteGridMesh(const char *filename, int size) {
+  FILE *f = fopen(filename, "w");
+  if (f == NULL) {
+    return false;
+  }
+
+  for (int y = 0; y <= size; y++) {
+    for (int x = 0; x <= size; x++) {
+      fprintf(f, "v %f %f 0\n", static_cast<float>(x) / size,
+          static_cast<float>(y) / size);
+    }
+  }
+
+  // Vertex indices in object files start from 1.
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int corner = y * (size + 1) + x + 1;
+      fprintf(f, "f %d %d %d\n", corner, corner + 1, corner + size + 1);
+      fprintf(f, "f %d %d %d\n", corner + 1, corner + size + 2,
+          corner + size + 1);
+    }
+  }
+
+  return fclose(f) == 0;
+}
+
+//! \brief Builds a mesh's triangles and edges in the old layout, and
+//! returns how many bytes their containers allocated.
+//!
+//! Only the bytes asked for are counted, not malloc's overhead on each of
+//! the many small set nodes, so the old layout's real size is larger.
+size_t LegacyConnectivityBytes(const ca::TriangleMesh &model) {
+  size_t start_bytes = counted_bytes;
+  std::vector<LegacyTriangle, CountingAllocator<LegacyTriangle> > triangles(
+      model.GetNumberOfTriangles());
+  std::vector<LegacyEdge, CountingAllocator<LegacyEdge> > edges(
+      model.GetNumberOfEdges());
+  for (int t = 0; t < model.GetNumberOfTriangles(); t++) {
+    triangles[t].id = t;
+    model.GetTriangle(t).GetVertexIndices(&triangles[t].vertices[0],
+        &triangles[t].vertices[1], &triangles[t].vertices[2]);
+  }
+  for (int e = 0; e < model.GetNumberOfEdges(); e++) {
+    const ca::Edge &edge = model.GetEdge(e);
+    edges[e].v1 = edge.v1();
+    edges[e].v2 = edge.v2();
+    for (int i = 0; i < edge.NumberOfTriangles(); i++) {
+      edges[e].triangles.insert(edge.triangle(i));
+    }
+  }
+  return counted_bytes - start_bytes;
+}
+
+//! \brief Prints out how to use the tool.
+void PrintUsage(const char *program) {
+  fprintf(stderr, "Usage: %s skin <object> <weights> <animation> <output> "
+      "[-threads n] [-normals] [-optimize] [-lod-budget vertices] "
+      "[-skeleton file]\n", program);
+  fprintf(stderr, "       %s optimize <object> <weights>\n", program);
+  fprintf(stderr, "       %s lod <object> <weights> <animation> "
+      "[-levels n] [-reduction fraction] [-threads n] [-skeleton file]\n",
+      program);
+  fprintf(stderr, "       %s bench-load [directory]\n", program);
+  fprintf(stderr, "       %s compress-anim <animation> <output> "
+      "[-tolerance degrees] [-skeleton file]\n", program);
+  fprintf(stderr, "       %s crowd <object> <weights> <animation> "
+      "[-max-instances n] [-threads n] [-skeleton file]\n", program);
+  fprintf(stderr, "       %s ik <animation> [-method ccd|fabrik] "
+      "[-iterations n] [-tolerance distance] [-characters n] "
+      "[-skeleton file]\n", program);
+  fprintf(stderr, "       %s bake <object> <weights> <animation> <output> "
+      "[-optimize] [-skeleton file] [-key-interval frames] [-threads n]\n",
+      program);
+}
+
+//! \brief Returns the number of seconds since a point in time.
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
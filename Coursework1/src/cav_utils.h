@@ -5,37 +5,19 @@
 #ifndef SRC_CAV_UTILS_H_
 #define SRC_CAV_UTILS_H_
 
-#include <vector>
-
-#include "./bone.h"
-#include "./edge.h"
-#include "./matrix-inl.h"
+#include "./fixed_matrix-inl.h"
 #include "./vector3d-inl.h"
 
 namespace computer_animation {
 
-//! \brief Searches a list of edges for an edge.
-//!
-//! Returns the index of the first match, or -1 if there are no matches.
-int FindEdge(const Edge &edge, const std::vector<Edge> &edge_list);
-
 //! \brief Creates an identity matrix.
-void CreateIdentityMatrix(Matrix<float> *f);
-
-//! \brief Creates a matrix to move an object in 3D space.
-void CreateTranslationMatrix(Matrix<float> *f,
-    const Vector3d<float> &translation);
+void CreateIdentityMatrix(Matrix4x4 *f);
 
-//! \brief Creates a matrix to rotate an object in the x-axis around
-//! the origin.
-void CreateXRotMatrix(Matrix<float> *f, float theta);
-
-//! \brief Creates a matrix to rotate an object in the y-axis around
-//! the origin.
-void CreateYRotMatrix(Matrix<float> *f, float theta);
-
-//! \brief Creates a matrix to rotate an object in the z-axis around
-//! the origin.
-void CreateZRotMatrix(Matrix<float> *f, float theta);
+//! \brief Creates the matrix for a rotation around the x-axis, then the
+//! y-axis, then the z-axis, by whole numbers of degrees.
+//!
+//! The result is Rx * Ry * Rz, built directly from the sine and cosine
+//! tables rather than by multiplying three single-axis matrices.
+void CreateXYZRotMatrix(Matrix3x3 *f, const Vector3d<int> &theta);
 }
 #endif  // SRC_CAV_UTILS_H_
@@ -1,13 +1,15 @@
 //! \author Stephen McGruer
 
-#include <algorithm>
-
 #include "./edge.h"
 
 namespace computer_animation {
 
 void Edge::AddTriangle(int triangle) {
-  triangles_.insert(triangle);
+  if (triangles_[0] < 0) {
+    triangles_[0] = triangle;
+  } else if (triangles_[1] < 0 && triangles_[0] != triangle) {
+    triangles_[1] = triangle;
+  }
 }
 
 bool Edge::operator== (const Edge &edge) const {
@@ -3,27 +3,30 @@
 #ifndef SRC_EDGE_H_
 #define SRC_EDGE_H_
 
-#include <map>
-#include <set>
-
 namespace computer_animation {
 
 //! \class Edge
 //! \brief Represents a non-directed edge between two vertices.
 //!
 //! The vertices are stored as indices into the TriangleMesh's list. Also
-//! stores a set of triangles that the edge is part of.
+//! stores the (at most two) triangles that the edge is part of, so that the
+//! triangle across an edge is found in constant time. An edge shared by
+//! more than two triangles only records the first two.
+//!
+//! Edges hold no pointers, so they can be stored in and mapped from a mesh
+//! cache as they are.
 class Edge {
   public:
     //! \brief Creates a new edge between vertices v1 and v2.
     Edge(int v1, int v2)
         : v1_(v1), v2_(v2) {
+      triangles_[0] = -1;
+      triangles_[1] = -1;
     }
 
     //! \brief Adds a triangle that the edge is part of.
     //!
-    //! Adding the same triangle multiple times will only add a single copy
-    //! to the Edge's set.
+    //! Adding the same triangle multiple times will only add a single copy.
     void AddTriangle(int triangle);
 
     //! \brief Returns the first vertex.
@@ -32,6 +35,23 @@ class Edge {
     //! \brief Returns the second vertex.
     inline const int v2() const { return v2_; }
 
+    //! \brief Returns the number of triangles the edge is part of.
+    //!
+    //! Edges on the boundary of the mesh have one triangle.
+    inline int NumberOfTriangles() const {
+      return (triangles_[0] >= 0) + (triangles_[1] >= 0);
+    }
+
+    //! \brief Returns the i-th triangle that the edge is part of, for i of
+    //! 0 or 1, or -1 if there is no such triangle.
+    inline int triangle(int i) const { return triangles_[i]; }
+
+    //! \brief Returns the triangle on the other side of the edge from the
+    //! given one, or -1 if the edge is on the boundary.
+    inline int OtherTriangle(int triangle) const {
+      return (triangles_[0] == triangle) ? triangles_[1] : triangles_[0];
+    }
+
     //! \brief Checks if two edges are equal.
     //!
     //! Two edges are considered equal if they have the same end-vertices,
@@ -40,7 +60,7 @@ class Edge {
 
   private:
     int v1_, v2_;
-    std::set<int> triangles_;
+    int triangles_[2];
 };
 }
 
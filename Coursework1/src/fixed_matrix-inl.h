@@ -0,0 +1,103 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_FIXED_MATRIX_INL_H_
+#define SRC_FIXED_MATRIX_INL_H_
+
+#include "./fixed_matrix.h"
+
+#include <cstdio>
+
+#include "./vector3d-inl.h"
+
+namespace computer_animation {
+
+template <typename T, int Rows, int Cols>
+FixedMatrix<T, Rows, Cols>::FixedMatrix() {
+  for (int i = 0; i < Rows * Cols; i++) {
+    data_[i] = T();
+  }
+}
+
+template <typename T, int Rows, int Cols> FixedMatrix<T, Rows, Cols>
+    FixedMatrix<T, Rows, Cols>::Identity() {
+  FixedMatrix<T, Rows, Cols> result;
+  for (int i = 0; i < Rows && i < Cols; i++) {
+    result(i, i) = 1;
+  }
+  return result;
+}
+
+template <typename T, int Rows, int Cols>
+void FixedMatrix<T, Rows, Cols>::PrintMatrix() const {
+  printf("FixedMatrix: %dx%d\n", Rows, Cols);
+  for (int row = 0; row < Rows; row++) {
+    printf("|");
+    for (int col = 0; col < Cols; col++) {
+      printf("%f ", operator()(row, col));
+    }
+    printf("|\n");
+  }
+  printf("\n");
+}
+
+template <typename T, int N> FixedVector<T, N>::FixedVector() {
+  for (int i = 0; i < N; i++) {
+    data_[i] = T();
+  }
+}
+
+template <typename T, int N> FixedVector<T, N>::FixedVector(
+    const Vector3d<T> &v, T w) {
+  data_[0] = v[0];
+  data_[1] = v[1];
+  data_[2] = v[2];
+  data_[3] = w;
+}
+
+template <typename T, int R, int K, int C> FixedMatrix<T, R, C> operator*(
+    const FixedMatrix<T, R, K> &a, const FixedMatrix<T, K, C> &b) {
+  FixedMatrix<T, R, C> result;
+  for (int i = 0; i < R; i++) {
+    for (int j = 0; j < C; j++) {
+      T sum = 0;
+      for (int k = 0; k < K; k++) {
+        sum += a(i, k) * b(k, j);
+      }
+      result(i, j) = sum;
+    }
+  }
+
+  return result;
+}
+
+template <typename T, int R, int C> FixedVector<T, R> operator*(
+    const FixedMatrix<T, R, C> &m, const FixedVector<T, C> &v) {
+  FixedVector<T, R> result;
+  for (int i = 0; i < R; i++) {
+    T sum = 0;
+    for (int k = 0; k < C; k++) {
+      sum += m(i, k) * v[k];
+    }
+    result[i] = sum;
+  }
+
+  return result;
+}
+
+inline Matrix4x4 ComposeAffine(const Matrix4x4 &a, const Matrix4x4 &b) {
+  Matrix4x4 result;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      result(i, j) = a(i, 0) * b(0, j) + a(i, 1) * b(1, j) +
+          a(i, 2) * b(2, j);
+    }
+    result(i, 3) = a(i, 0) * b(0, 3) + a(i, 1) * b(1, 3) +
+        a(i, 2) * b(2, 3) + a(i, 3);
+  }
+  result(3, 3) = 1.0f;
+
+  return result;
+}
+}
+
+#endif  // SRC_FIXED_MATRIX_INL_H_
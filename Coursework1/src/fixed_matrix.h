@@ -0,0 +1,103 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_FIXED_MATRIX_H_
+#define SRC_FIXED_MATRIX_H_
+
+#include "./vector3d.h"
+
+namespace computer_animation {
+
+//! \class FixedMatrix
+//! \brief Represents a Rows-by-Cols matrix whose size is known at compile
+//! time.
+//!
+//! The elements are stored inline, so creating, copying and multiplying
+//! FixedMatrix objects never touches the heap. Element access is via the
+//! () operator.
+template <typename T, int Rows, int Cols> class FixedMatrix {
+  public:
+    //! \brief Creates a zero matrix.
+    FixedMatrix();
+
+    //! \brief Returns an identity matrix.
+    static FixedMatrix Identity();
+
+    //! \brief Returns the number of rows that the matrix has.
+    int num_rows() const { return Rows; }
+
+    //! \brief Returns the number of columns that the matrix has.
+    int num_cols() const { return Cols; }
+
+    //! \brief Returns the element in the row-th row, col-th column.
+    T operator() (int row, int col) const { return data_[row * Cols + col]; }
+
+    //! \brief Returns the element in the row-th row, col-th column.
+    T& operator() (int row, int col) { return data_[row * Cols + col]; }
+
+    //! \brief Returns the elements, stored row-major.
+    const T* data() const { return data_; }
+
+    //! \brief Prints out the matrix in a (reasonably) human-readable format.
+    void PrintMatrix() const;
+
+  private:
+    T data_[Rows * Cols];
+};
+
+//! \class FixedVector
+//! \brief Represents an N-element column vector whose size is known at
+//! compile time.
+template <typename T, int N> class FixedVector {
+  public:
+    //! \brief Creates a zero vector.
+    FixedVector();
+
+    //! \brief Creates the homogeneous vector (v[0], v[1], v[2], w).
+    //!
+    //! Only valid when N is 4.
+    FixedVector(const Vector3d<T> &v, T w);
+
+    //! \brief Returns the i-th element of the vector.
+    //!
+    //! Does not perform bounds checking.
+    T operator[] (int i) const { return data_[i]; }
+
+    //! \brief Returns the i-th element of the vector.
+    //!
+    //! Does not perform bounds checking.
+    T& operator[] (int i) { return data_[i]; }
+
+  private:
+    T data_[N];
+};
+
+//! \brief A 4x4 float matrix, used for homogeneous 3D transforms.
+typedef FixedMatrix<float, 4, 4> Matrix4x4;
+
+//! \brief A 3x3 float matrix, used for 3D rotations.
+typedef FixedMatrix<float, 3, 3> Matrix3x3;
+
+//! \brief The top three rows of an affine 4x4 float matrix.
+//!
+//! The bottom row is implicitly (0, 0, 0, 1).
+typedef FixedMatrix<float, 3, 4> Matrix3x4;
+
+//! \brief A homogeneous 3D float vector.
+typedef FixedVector<float, 4> Vector4;
+
+//! \brief Multiplies two matrices together.
+template <typename T, int R, int K, int C> FixedMatrix<T, R, C> operator*(
+    const FixedMatrix<T, R, K> &a, const FixedMatrix<T, K, C> &b);
+
+//! \brief Multiplies a vector by a matrix.
+template <typename T, int R, int C> FixedVector<T, R> operator*(
+    const FixedMatrix<T, R, C> &m, const FixedVector<T, C> &v);
+
+//! \brief Composes two affine transforms, returning a * b.
+//!
+//! Both matrices must have a bottom row of (0, 0, 0, 1). This skips the
+//! work that operator* would spend on the bottom row.
+inline Matrix4x4 ComposeAffine(const Matrix4x4 &a, const Matrix4x4 &b);
+}
+
+#endif  // SRC_FIXED_MATRIX_H_
@@ -0,0 +1,195 @@
+//! \author Stephen McGruer
+
+#include "./frame_pipeline.h"
+
+#include <cstring>
+
+namespace computer_animation {
+
+namespace {
+
+// Returns true if two skeletons have the same bones in the same pose.
+bool SamePose(const Skeleton &a, const Skeleton &b) {
+  if (a.GetNumberBones() != b.GetNumberBones()) {
+    return false;
+  }
+  for (int i = 0; i < a.GetNumberBones(); i++) {
+    if (!(a.Rotation(i) == b.Rotation(i)) ||
+        !(a.CurrentPosition(i) == b.CurrentPosition(i)) ||
+        a.ParentIndex(i) != b.ParentIndex(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Wakes a thread waiting on a condition, if its flag says it is waiting.
+// The condition must have been made true before this is called.
+//
+// The waiting thread sets its flag and then checks the condition, with the
+// mutex held. Either it sees the condition, or the flag is seen here and
+// taking the mutex makes sure that it is waiting before it is woken.
+void Wake(const std::atomic<bool> &waiting, std::mutex *mutex,
+    std::condition_variable *condition) {
+  if (waiting.load()) {
+    { std::lock_guard<std::mutex> lock(*mutex); }
+    condition->notify_one();
+  }
+}
+}  // namespace
+
+FramePipeline::FramePipeline()
+    : engine_(NULL),
+      controller_(NULL),
+      num_requests_(0),
+      latest_frame_(NULL),
+      worker_mesh_(NULL),
+      worker_waiting_(false),
+      drawer_waiting_(false),
+      stopping_(false) {
+}
+
+FramePipeline::~FramePipeline() {
+  Stop();
+}
+
+void FramePipeline::Start(SkinningEngine *engine,
+    AnimationController *controller, const Skeleton &skeleton) {
+  Stop();
+  engine_ = engine;
+  controller_ = controller;
+  worker_mesh_ = NULL;
+  worker_pose_ = skeleton;
+  stopping_.store(false);
+  worker_ = std::thread(&FramePipeline::WorkerLoop, this);
+}
+
+void FramePipeline::Stop() {
+  if (!worker_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_.store(true);
+  }
+  request_ready_.notify_one();
+  worker_.join();
+}
+
+void FramePipeline::RequestPose(const TriangleMesh &mesh,
+    const Skeleton &skeleton) {
+  if (num_requests_ > 0 && !last_request_.animated &&
+      last_request_.mesh == &mesh && SamePose(last_request_.pose, skeleton)) {
+    return;
+  }
+  last_request_.mesh = &mesh;
+  last_request_.animated = false;
+  last_request_.pose = skeleton;
+
+  FrameRequest* request = requests_.back();
+  request->mesh = &mesh;
+  request->animated = false;
+  request->pose = skeleton;
+  Submit();
+}
+
+void FramePipeline::RequestAnimation(const TriangleMesh &mesh, float t) {
+  if (num_requests_ > 0 && last_request_.animated &&
+      last_request_.mesh == &mesh && last_request_.time == t) {
+    return;
+  }
+  last_request_.mesh = &mesh;
+  last_request_.animated = true;
+  last_request_.time = t;
+
+  FrameRequest* request = requests_.back();
+  request->mesh = &mesh;
+  request->animated = true;
+  request->time = t;
+  Submit();
+}
+
+const SkinnedFrame* FramePipeline::LatestFrame() {
+  if (frames_.Update()) {
+    latest_frame_ = frames_.front();
+  }
+  return latest_frame_;
+}
+
+const SkinnedFrame* FramePipeline::WaitForFrame() {
+  LatestFrame();
+  while (running() && num_requests_ > 0 && !up_to_date()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      drawer_waiting_.store(true);
+      while (!frames_.HasUpdate()) {
+        frame_ready_.wait(lock);
+      }
+      drawer_waiting_.store(false);
+    }
+    LatestFrame();
+  }
+  return latest_frame_;
+}
+
+void FramePipeline::Submit() {
+  requests_.back()->number = ++num_requests_;
+  requests_.Publish();
+  Wake(worker_waiting_, &mutex_, &request_ready_);
+}
+
+void FramePipeline::WorkerLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      worker_waiting_.store(true);
+      while (!stopping_.load() && !requests_.HasUpdate()) {
+        request_ready_.wait(lock);
+      }
+      worker_waiting_.store(false);
+    }
+    if (stopping_.load()) {
+      return;
+    }
+
+    requests_.Update();
+    SkinFrame(*requests_.front());
+    frames_.Publish();
+    Wake(drawer_waiting_, &mutex_, &frame_ready_);
+  }
+}
+
+void FramePipeline::SkinFrame(const FrameRequest &request) {
+  if (request.mesh != worker_mesh_) {
+    bool normals_enabled = engine_->normals_enabled();
+    engine_->Init(*request.mesh);
+    engine_->SetNormalsEnabled(normals_enabled);
+    worker_mesh_ = request.mesh;
+  }
+
+  if (request.animated) {
+    controller_->Sample(request.time, &worker_pose_);
+  } else {
+    worker_pose_ = request.pose;
+  }
+  engine_->Skin(&worker_pose_);
+
+  SkinnedFrame* frame = frames_.back();
+  frame->request = request.number;
+  frame->mesh = request.mesh;
+  frame->pose = worker_pose_;
+  int num_values = 3 * engine_->num_vertices();
+  if (frame->num_vertices != engine_->num_vertices() ||
+      frame->positions.size() != num_values) {
+    frame->num_vertices = engine_->num_vertices();
+    frame->positions.Resize(num_values);
+    frame->normals.Resize(num_values);
+  }
+  memcpy(frame->positions.data(), engine_->positions(),
+      num_values * sizeof(float));
+  if (engine_->normals_enabled()) {
+    memcpy(frame->normals.data(), engine_->normals(),
+        num_values * sizeof(float));
+  }
+}
+}
@@ -0,0 +1,167 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_FRAME_PIPELINE_H_
+#define SRC_FRAME_PIPELINE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "./aligned_array.h"
+#include "./animation_controller.h"
+#include "./skeleton.h"
+#include "./skinning_engine.h"
+#include "./triangle_mesh.h"
+#include "./triple_buffer.h"
+
+namespace computer_animation {
+
+//! \struct SkinnedFrame
+//! \brief A frame skinned by a FramePipeline, ready to be drawn.
+struct SkinnedFrame {
+  SkinnedFrame() : request(0), mesh(NULL), num_vertices(0) {}
+
+  // The number of the request the frame answers, counting from 1.
+  uint64_t request;
+
+  // The mesh that was skinned, and the pose it was skinned in.
+  const TriangleMesh* mesh;
+  Skeleton pose;
+
+  // The skinned positions and normals, as (x, y, z) triples.
+  int num_vertices;
+  AlignedArray<float> positions;
+  AlignedArray<float> normals;
+};
+
+//! \class FramePipeline
+//! \brief Poses and skins frames on a worker thread, while another thread
+//! draws the frames finished before them.
+//!
+//! The drawing thread asks for a frame, either of a pose or of a point in
+//! an animation, and draws the newest frame the worker has finished, which
+//! is usually the one asked for the time before. The worker meanwhile
+//! samples the animation and skins the new frame, so a frame takes the
+//! longer of drawing and skinning rather than the sum of them.
+//!
+//! Requests and finished frames are each handed over through a
+//! TripleBuffer, so neither thread ever waits for the other to hand
+//! something over; if the worker falls behind, it skips to the newest
+//! request. The worker sleeps while there is nothing to do, and the
+//! drawing thread can wait for the frame it asked for last with
+//! WaitForFrame(), e.g. to show a keyboard edit straight away.
+class FramePipeline {
+  public:
+    FramePipeline();
+
+    //! \brief Stops the worker, if it is running.
+    ~FramePipeline();
+
+    //! \brief Starts the worker thread.
+    //!
+    //! The worker skins with engine and samples animations from controller,
+    //! which must be left alone until Stop() is called. skeleton gives the
+    //! bones that animations are sampled for. The engine's normals are
+    //! computed if they are enabled when it starts.
+    void Start(SkinningEngine *engine, AnimationController *controller,
+        const Skeleton &skeleton);
+
+    //! \brief Stops the worker thread, once it has finished its frame.
+    void Stop();
+
+    //! \brief Returns true if the worker is running.
+    inline bool running() const { return worker_.joinable(); }
+
+    //! \brief Asks for a frame of a mesh in a skeleton's pose.
+    //!
+    //! Does nothing if the last request was for the same mesh in the same
+    //! pose. The mesh must not change while the worker is running.
+    void RequestPose(const TriangleMesh &mesh, const Skeleton &skeleton);
+
+    //! \brief Asks for a frame of a mesh t seconds into the animation.
+    //!
+    //! Does nothing if the last request was for the same mesh at the same
+    //! time.
+    void RequestAnimation(const TriangleMesh &mesh, float t);
+
+    //! \brief Returns the newest frame the worker has finished, or NULL if
+    //! it has not finished any. Never waits.
+    //!
+    //! The frame stays valid, and unchanged, until the next call to
+    //! LatestFrame() or WaitForFrame().
+    const SkinnedFrame* LatestFrame();
+
+    //! \brief Waits for the worker to finish the frame asked for last, and
+    //! returns it.
+    //!
+    //! Returns the same as LatestFrame() if nothing has been asked for.
+    const SkinnedFrame* WaitForFrame();
+
+    //! \brief Returns true if the frame that LatestFrame() or
+    //! WaitForFrame() returned last answers the last request.
+    inline bool up_to_date() const {
+      return latest_frame_ != NULL && latest_frame_->request == num_requests_;
+    }
+
+  private:
+    // A frame that has been asked for.
+    struct FrameRequest {
+      FrameRequest() : number(0), mesh(NULL), animated(false), time(0.0f) {}
+
+      uint64_t number;
+      const TriangleMesh* mesh;
+
+      // Whether the pose is sampled from the animation at time, or given.
+      bool animated;
+      float time;
+      Skeleton pose;
+    };
+
+    // Copying is not allowed.
+    FramePipeline(const FramePipeline&);
+    FramePipeline& operator=(const FramePipeline&);
+
+    // Numbers the back request, publishes it and wakes the worker.
+    void Submit();
+
+    // The main loop of the worker thread.
+    void WorkerLoop();
+
+    // Poses the worker's skeleton and skins the mesh for a request, into
+    // the back frame.
+    void SkinFrame(const FrameRequest &request);
+
+    SkinningEngine* engine_;
+    AnimationController* controller_;
+    std::thread worker_;
+
+    TripleBuffer<FrameRequest> requests_;
+    TripleBuffer<SkinnedFrame> frames_;
+
+    // Used only by the drawing thread: the number of requests made, the
+    // last one (to spot repeats), and the frame last taken.
+    uint64_t num_requests_;
+    FrameRequest last_request_;
+    const SkinnedFrame* latest_frame_;
+
+    // Used only by the worker: the mesh its engine was last set up for,
+    // and the skeleton it poses.
+    const TriangleMesh* worker_mesh_;
+    Skeleton worker_pose_;
+
+    // Used only to sleep and wake the threads; the frames and requests are
+    // handed over without locking. A thread sets its flag while it waits,
+    // so the other only takes the lock to wake it when it needs to.
+    std::mutex mutex_;
+    std::condition_variable request_ready_;
+    std::condition_variable frame_ready_;
+    std::atomic<bool> worker_waiting_;
+    std::atomic<bool> drawer_waiting_;
+    std::atomic<bool> stopping_;
+};
+}
+
+#endif  // SRC_FRAME_PIPELINE_H_
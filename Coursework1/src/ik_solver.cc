@@ -0,0 +1,336 @@
+//! \author Stephen McGruer
+
+#include "./ik_solver.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "./cav_utils.h"
+
+namespace computer_animation {
+
+namespace {
+
+// Vectors shorter than this are treated as having no direction.
+const float kMinimumLength = 1e-6f;
+
+// The size of |sin(y)| above which an XYZ rotation is treated as being in
+// gimbal lock, where only x + z (or x - z) can be recovered.
+const float kGimbalLockSine = 0.99999f;
+
+const double kDegreesPerRadian = 180.0 / M_PI;
+
+float Dot(const Vector3d<float> &a, const Vector3d<float> &b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Sets direction to v scaled to unit length. Returns false, leaving
+// direction alone, if v is too short to have a direction.
+bool Direction(const Vector3d<float> &v, Vector3d<float> *direction) {
+  float length = std::sqrt(Dot(v, v));
+  if (length < kMinimumLength) {
+    return false;
+  }
+  *direction = Vector3d<float>(v[0] / length, v[1] / length, v[2] / length);
+  return true;
+}
+
+// Builds the smallest rotation that turns the unit vector from onto the
+// unit vector to. Returns false if they already point the same way.
+bool RotationBetween(const Vector3d<float> &from, const Vector3d<float> &to,
+    Matrix3x3 *r) {
+  float c = Dot(from, to);
+  Vector3d<float> axis = CrossProduct(from, to);
+  float s = std::sqrt(Dot(axis, axis));
+  if (s < kMinimumLength) {
+    if (c > 0.0f) {
+      return false;
+    }
+    // Opposite directions: turn half way round any perpendicular axis.
+    axis = CrossProduct(from, std::fabs(from[0]) < 0.9f ?
+        Vector3d<float>(1, 0, 0) : Vector3d<float>(0, 1, 0));
+    s = std::sqrt(Dot(axis, axis));
+  }
+  axis /= s;
+
+  // Rodrigues' formula, R = cI + s[k]x + (1 - c)kk^T, for the unit axis k.
+  float t = 1.0f - c;
+  float x = axis[0];
+  float y = axis[1];
+  float z = axis[2];
+  (*r)(0, 0) = c + t * x * x;
+  (*r)(0, 1) = t * x * y - s * z;
+  (*r)(0, 2) = t * x * z + s * y;
+  (*r)(1, 0) = t * x * y + s * z;
+  (*r)(1, 1) = c + t * y * y;
+  (*r)(1, 2) = t * y * z - s * x;
+  (*r)(2, 0) = t * x * z - s * y;
+  (*r)(2, 1) = t * y * z + s * x;
+  (*r)(2, 2) = c + t * z * z;
+  return true;
+}
+
+int RoundDegrees(double radians) {
+  return static_cast<int>(std::floor(radians * kDegreesPerRadian + 0.5));
+}
+
+// Finds the whole-degree rotations around the x, y and z-axes that
+// CreateXYZRotMatrix() would turn into r (or the closest to it).
+Vector3d<int> DecomposeXYZRotation(const Matrix3x3 &r) {
+  // r = Rx * Ry * Rz, so r(0, 2) = sin(y), and the rest of the top row
+  // and right column give z and x.
+  float sin_y = r(0, 2);
+  if (sin_y > 1.0f) {
+    sin_y = 1.0f;
+  } else if (sin_y < -1.0f) {
+    sin_y = -1.0f;
+  }
+  double y = std::asin(sin_y);
+  double x;
+  double z;
+  if (std::fabs(sin_y) < kGimbalLockSine) {
+    x = std::atan2(-r(1, 2), r(2, 2));
+    z = std::atan2(-r(0, 1), r(0, 0));
+  } else {
+    x = std::atan2(r(2, 1), r(1, 1));
+    z = 0.0;
+  }
+  return Vector3d<int>(RoundDegrees(x), RoundDegrees(y), RoundDegrees(z));
+}
+
+// Returns the rotation part of a bone's world transform.
+Matrix3x3 WorldRotation(const Matrix4x4 &m) {
+  Matrix3x3 r;
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      r(row, col) = m(row, col);
+    }
+  }
+  return r;
+}
+
+Matrix3x3 Transpose(const Matrix3x3 &m) {
+  Matrix3x3 t;
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      t(row, col) = m(col, row);
+    }
+  }
+  return t;
+}
+}  // namespace
+
+IkSolver::IkSolver()
+    : chain_offsets_(1, 0),
+      method_(kCcdMethod),
+      tolerance_(kDefaultIkTolerance),
+      max_iterations_(kDefaultIkIterations) {
+}
+
+void IkSolver::Init(const Skeleton &skeleton) {
+  int num_bones = skeleton.GetNumberBones();
+  num_children_.assign(num_bones, 0);
+  for (int i = 0; i < num_bones; i++) {
+    if (skeleton.ParentIndex(i) >= 0) {
+      num_children_[skeleton.ParentIndex(i)]++;
+    }
+  }
+  const int* parents = skeleton.parent_indices().data();
+  parent_indices_.assign(parents, parents + num_bones);
+  const Vector3d<float>* rest = skeleton.rest_positions().data();
+  rest_positions_.assign(rest, rest + num_bones);
+
+  effector_bones_.clear();
+  targets_.clear();
+  chain_offsets_.assign(1, 0);
+  chain_bones_.clear();
+  joints_.clear();
+  lengths_.clear();
+}
+
+int IkSolver::AddEffector(int bone, int chain_length) {
+  if (bone < 0 || bone >= static_cast<int>(parent_indices_.size())) {
+    return -1;
+  }
+
+  // Walk up from the effector's bone, stopping below the root, after
+  // chain_length bones, or (with a chain_length of 0) at a branch.
+  int length = 0;
+  int current = bone;
+  while (current >= 0 && parent_indices_[current] >= 0 &&
+         (chain_length <= 0 || length < chain_length)) {
+    chain_bones_.push_back(current);
+    length++;
+    int parent = parent_indices_[current];
+    if (chain_length <= 0 && num_children_[parent] != 1) {
+      break;
+    }
+    current = parent;
+  }
+  chain_offsets_.push_back(chain_bones_.size());
+
+  effector_bones_.push_back(bone);
+  Vector3d<float> rest = rest_positions_[bone];
+  targets_.push_back(rest - rest_positions_[0]);
+
+  // Make sure FABRIK has room for the chain, so solving never allocates.
+  if (static_cast<int>(lengths_.size()) < length) {
+    lengths_.resize(length);
+    joints_.resize(length + 1);
+  }
+  return effector_bones_.size() - 1;
+}
+
+IkResult IkSolver::Solve(Skeleton *skeleton) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  skeleton->UpdateTransforms();
+  IkResult result;
+  result.iterations = 0;
+  result.error = MaxError(*skeleton);
+  while (result.error > tolerance_ && result.iterations < max_iterations_) {
+    bool moved = method_ == kFabrikMethod ? FabrikIteration(skeleton) :
+        CcdIteration(skeleton);
+    result.iterations++;
+    result.error = MaxError(*skeleton);
+    if (!moved) {
+      // Every turn rounded away to nothing, so further iterations would
+      // do the same.
+      break;
+    }
+  }
+  result.converged = result.error <= tolerance_;
+
+  result.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+Vector3d<float> IkSolver::JointPosition(const Skeleton &skeleton, int bone) {
+  // The joint is the origin of the bone's frame.
+  const Matrix4x4 &m = skeleton.transforms()[bone];
+  return Vector3d<float>(m(0, 3), m(1, 3), m(2, 3));
+}
+
+float IkSolver::MaxError(const Skeleton &skeleton) const {
+  float error = 0.0f;
+  for (int e = 0; e < num_effectors(); e++) {
+    float distance =
+        JointPosition(skeleton, effector_bones_[e]).DistanceTo(targets_[e]);
+    if (distance > error) {
+      error = distance;
+    }
+  }
+  return error;
+}
+
+bool IkSolver::CcdIteration(Skeleton *skeleton) {
+  bool moved = false;
+  for (int e = 0; e < num_effectors(); e++) {
+    int effector = effector_bones_[e];
+    for (int k = chain_offsets_[e]; k < chain_offsets_[e + 1]; k++) {
+      // Turn the bone about its parent's joint so that the effector lies
+      // on the line from that joint to the target.
+      int bone = chain_bones_[k];
+      Vector3d<float> pivot =
+          JointPosition(*skeleton, skeleton->ParentIndex(bone));
+      moved |= TurnBone(skeleton, bone,
+          JointPosition(*skeleton, effector) - pivot, targets_[e] - pivot);
+    }
+  }
+  return moved;
+}
+
+bool IkSolver::FabrikIteration(Skeleton *skeleton) {
+  bool moved = false;
+  for (int e = 0; e < num_effectors(); e++) {
+    // joints_[0] is the effector, and joints_[n] the fixed joint that the
+    // chain hangs from. lengths_[k] is the distance between joints k and
+    // k + 1.
+    const int* bones = chain_bones_.data() + chain_offsets_[e];
+    int n = chain_length(e);
+    if (n == 0) {
+      continue;
+    }
+    for (int k = 0; k < n; k++) {
+      joints_[k] = JointPosition(*skeleton, bones[k]);
+    }
+    joints_[n] = JointPosition(*skeleton, skeleton->ParentIndex(bones[n - 1]));
+    float reach = 0.0f;
+    for (int k = 0; k < n; k++) {
+      lengths_[k] = joints_[k].DistanceTo(joints_[k + 1]);
+      reach += lengths_[k];
+    }
+
+    const Vector3d<float> &target = targets_[e];
+    Vector3d<float> direction;
+    if (joints_[n].DistanceTo(target) >= reach) {
+      // Out of reach: stretch the chain straight towards the target.
+      if (Direction(target - joints_[n], &direction)) {
+        for (int k = n - 1; k >= 0; k--) {
+          joints_[k] = direction;
+          joints_[k] *= lengths_[k];
+          joints_[k] += joints_[k + 1];
+        }
+      }
+    } else {
+      // Backward pass: put the effector on the target and pull each joint
+      // towards the one below it.
+      joints_[0] = target;
+      for (int k = 1; k < n; k++) {
+        if (Direction(joints_[k] - joints_[k - 1], &direction)) {
+          direction *= lengths_[k - 1];
+          joints_[k] = joints_[k - 1] + direction;
+        }
+      }
+      // Forward pass: pull the chain back onto its fixed joint.
+      for (int k = n - 1; k >= 0; k--) {
+        if (Direction(joints_[k] - joints_[k + 1], &direction)) {
+          direction *= lengths_[k];
+          joints_[k] = joints_[k + 1] + direction;
+        }
+      }
+    }
+
+    // Turn the bones to match, from the top of the chain down, aiming each
+    // from wherever its parent's joint ended up.
+    for (int k = n - 1; k >= 0; k--) {
+      int bone = bones[k];
+      Vector3d<float> pivot =
+          JointPosition(*skeleton, skeleton->ParentIndex(bone));
+      moved |= TurnBone(skeleton, bone, JointPosition(*skeleton, bone) - pivot,
+          joints_[k] - pivot);
+    }
+  }
+  return moved;
+}
+
+bool IkSolver::TurnBone(Skeleton *skeleton, int bone,
+    const Vector3d<float> &from, const Vector3d<float> &to) {
+  Vector3d<float> from_direction;
+  Vector3d<float> to_direction;
+  Matrix3x3 q;
+  if (!Direction(from, &from_direction) || !Direction(to, &to_direction) ||
+      !RotationBetween(from_direction, to_direction, &q)) {
+    return false;
+  }
+
+  // The bone's world rotation is A * R, where A is its parent's world
+  // rotation and R its own. Turning it by q in world space makes it
+  // q * A * R = A * (A^T * q * A * R), so its new rotation is
+  // A^T * q * A * R.
+  Matrix3x3 a = WorldRotation(
+      skeleton->transforms()[skeleton->ParentIndex(bone)]);
+  Matrix3x3 r;
+  CreateXYZRotMatrix(&r, skeleton->Rotation(bone));
+  Matrix3x3 turned = Transpose(a) * (q * (a * r));
+  Vector3d<int> rotation = DecomposeXYZRotation(turned);
+  if (rotation == skeleton->Rotation(bone)) {
+    return false;
+  }
+  skeleton->SetRotation(bone, rotation);
+  skeleton->UpdateTransforms();
+  return true;
+}
+}
@@ -0,0 +1,183 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_IK_SOLVER_H_
+#define SRC_IK_SOLVER_H_
+
+#include <vector>
+
+#include "./skeleton.h"
+
+namespace computer_animation {
+
+//! \brief The inverse kinematics methods that an IkSolver can use.
+enum IkMethod {
+  kCcdMethod,
+  kFabrikMethod
+};
+
+//! \brief The default largest distance between an effector and its target
+//! that counts as reaching it, in model units.
+const float kDefaultIkTolerance = 0.01f;
+
+//! \brief The default largest number of iterations per solve.
+const int kDefaultIkIterations = 16;
+
+//! \brief The bones of the feet and hands of the skeleton in skeleton2.out:
+//! the right foot, left foot, left hand and right hand.
+const int kLimbEndBones[] = {4, 21, 12, 17};
+
+//! \brief The number of bones in kLimbEndBones.
+const int kNumLimbEndBones = sizeof(kLimbEndBones) / sizeof(kLimbEndBones[0]);
+
+//! \struct IkResult
+//! \brief What happened during a call to IkSolver::Solve().
+struct IkResult {
+  // The number of iterations run.
+  int iterations;
+
+  // The largest distance left between an effector and its target.
+  float error;
+
+  // Whether every effector came within the tolerance of its target.
+  bool converged;
+
+  // How long the solve took, in seconds.
+  double seconds;
+};
+
+//! \class IkSolver
+//! \brief Poses a skeleton so that chosen bones reach target positions.
+//!
+//! Each effector is a bone whose joint should reach a target, and the chain
+//! of bones above it that may be rotated to get it there. Positions are in
+//! the space of the skinned mesh, as given by Skeleton::transforms().
+//!
+//! Two methods are available. Cyclic coordinate descent (CCD) turns each
+//! bone of a chain in turn, from the effector up, so that the effector
+//! points at the target. FABRIK (forward and backward reaching inverse
+//! kinematics) moves the joints of a chain along the lines between them,
+//! first pulling the effector onto the target and then pulling the base
+//! back into place, and then turns each bone to match. Each iteration runs
+//! one pass of the method over every effector in turn, so effectors whose
+//! chains overlap share them. There are no joint limits.
+//!
+//! Rotations are stored in whole degrees, so a chain can only place its
+//! effector to within about a degree's turn of its longest bone.
+//!
+//! All of the working space is allocated when effectors are added, so
+//! Solve() never allocates memory, and a solver can be reused for any
+//! number of skeletons with the same bones.
+class IkSolver {
+  public:
+    IkSolver();
+
+    //! \brief Prepares the solver for skeletons with the same bones as the
+    //! given one, and removes any effectors.
+    void Init(const Skeleton &skeleton);
+
+    //! \brief Adds an effector at a bone, and returns its index, or -1 if
+    //! the skeleton has no such bone.
+    //!
+    //! Up to chain_length bones, starting with the effector's own bone and
+    //! going up towards the root, are rotated to reach the target. The root
+    //! cannot be rotated, so chains stop below it. A chain_length of 0
+    //! takes the bones up to (and not including) the first joint with
+    //! another child, so a limb moves without dragging the body. The
+    //! target starts out at the bone's rest position.
+    int AddEffector(int bone, int chain_length);
+
+    //! \brief Returns the number of effectors.
+    inline int num_effectors() const { return effector_bones_.size(); }
+
+    //! \brief Returns the bone of the i-th effector.
+    inline int effector_bone(int i) const { return effector_bones_[i]; }
+
+    //! \brief Returns the number of bones in the i-th effector's chain.
+    inline int chain_length(int i) const {
+      return chain_offsets_[i + 1] - chain_offsets_[i];
+    }
+
+    //! \brief Sets the target of the i-th effector.
+    inline void SetTarget(int i, const Vector3d<float> &target) {
+      targets_[i] = target;
+    }
+
+    //! \brief Returns the target of the i-th effector.
+    inline const Vector3d<float>& target(int i) const { return targets_[i]; }
+
+    //! \brief Returns the method used. CCD by default.
+    inline IkMethod method() const { return method_; }
+
+    //! \brief Sets the method used.
+    inline void SetMethod(IkMethod method) { method_ = method; }
+
+    //! \brief Returns the distance within which an effector counts as
+    //! having reached its target.
+    inline float tolerance() const { return tolerance_; }
+
+    //! \brief Sets the distance within which an effector counts as having
+    //! reached its target.
+    inline void SetTolerance(float tolerance) { tolerance_ = tolerance; }
+
+    //! \brief Returns the largest number of iterations per solve.
+    inline int max_iterations() const { return max_iterations_; }
+
+    //! \brief Sets the largest number of iterations per solve.
+    inline void SetMaxIterations(int iterations) {
+      max_iterations_ = iterations;
+    }
+
+    //! \brief Rotates the skeleton's bones to move the effectors to their
+    //! targets.
+    //!
+    //! Stops once every effector is within the tolerance of its target,
+    //! after max_iterations() iterations, or once an iteration leaves every
+    //! rotation as it was (because the turns left are under half a degree),
+    //! whichever comes first. The skeleton's transforms are left up to date.
+    IkResult Solve(Skeleton *skeleton);
+
+    //! \brief Returns the position of a bone's joint in a skeleton, as of
+    //! its last call to Skeleton::UpdateTransforms().
+    static Vector3d<float> JointPosition(const Skeleton &skeleton, int bone);
+
+  private:
+    // Returns the largest distance between an effector and its target.
+    float MaxError(const Skeleton &skeleton) const;
+
+    // Runs one iteration of CCD or FABRIK over every effector. Returns
+    // false if no bone turned.
+    bool CcdIteration(Skeleton *skeleton);
+    bool FabrikIteration(Skeleton *skeleton);
+
+    // Turns a bone about its parent's joint so that its joint moves from
+    // pointing along from to pointing along to, as seen from the parent's
+    // joint, and brings the skeleton's transforms up to date. Returns false
+    // if the turn rounds to no change in the bone's rotation.
+    bool TurnBone(Skeleton *skeleton, int bone, const Vector3d<float> &from,
+        const Vector3d<float> &to);
+
+    // The skeleton's bones, and the number of children each has.
+    std::vector<int> parent_indices_;
+    std::vector<Vector3d<float> > rest_positions_;
+    std::vector<int> num_children_;
+
+    // The bone and target of each effector, and its chain, from the
+    // effector's bone upwards. Effector i's chain is
+    // chain_bones_[chain_offsets_[i]] to chain_bones_[chain_offsets_[i + 1]].
+    std::vector<int> effector_bones_;
+    std::vector<Vector3d<float> > targets_;
+    std::vector<int> chain_offsets_;
+    std::vector<int> chain_bones_;
+
+    // Scratch space for FABRIK: the joint positions and bone lengths of a
+    // chain, with room for the longest chain plus its base.
+    std::vector<Vector3d<float> > joints_;
+    std::vector<float> lengths_;
+
+    IkMethod method_;
+    float tolerance_;
+    int max_iterations_;
+};
+}
+
+#endif  // SRC_IK_SOLVER_H_
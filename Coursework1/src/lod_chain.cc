@@ -0,0 +1,561 @@
+//! \author Stephen McGruer
+
+#include "./lod_chain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace computer_animation {
+
+namespace {
+
+// How much more a boundary edge resists moving than an interior one.
+const double kBoundaryWeight = 100.0;
+
+// A quadric error: the sum of the squared distances from a point to a set
+// of planes, stored as the upper triangle of a symmetric 4x4 matrix.
+class Quadric {
+  public:
+    Quadric() {
+      std::fill(q_, q_ + 10, 0.0);
+    }
+
+    // Adds the plane n.p + d = 0, where n has unit length.
+    void AddPlane(double nx, double ny, double nz, double d, double weight) {
+      q_[0] += weight * nx * nx;
+      q_[1] += weight * nx * ny;
+      q_[2] += weight * nx * nz;
+      q_[3] += weight * nx * d;
+      q_[4] += weight * ny * ny;
+      q_[5] += weight * ny * nz;
+      q_[6] += weight * ny * d;
+      q_[7] += weight * nz * nz;
+      q_[8] += weight * nz * d;
+      q_[9] += weight * d * d;
+    }
+
+    Quadric& operator+= (const Quadric &other) {
+      for (int i = 0; i < 10; i++) {
+        q_[i] += other.q_[i];
+      }
+      return *this;
+    }
+
+    // Returns the error of placing a vertex at p.
+    double Evaluate(const Vector3d<float> &p) const {
+      double x = p[0];
+      double y = p[1];
+      double z = p[2];
+      return x * (q_[0] * x + 2.0 * (q_[1] * y + q_[2] * z + q_[3])) +
+          y * (q_[4] * y + 2.0 * (q_[5] * z + q_[6])) +
+          z * (q_[7] * z + 2.0 * q_[8]) + q_[9];
+    }
+
+  private:
+    double q_[10];
+};
+
+// A candidate edge collapse, which moves v1 to target and removes v2. The
+// versions of the vertices when it was costed are kept, so that it can be
+// ignored if either has changed since.
+struct Collapse {
+  double cost;
+  int v1, v2;
+  int version1, version2;
+  Vector3d<float> target;
+  float t;  // How far along the edge from v1 to v2 the target is.
+
+  // Orders the queue so the cheapest collapse is on top.
+  bool operator< (const Collapse &other) const {
+    return cost > other.cost;
+  }
+};
+
+// Orders influences so that the largest weight comes first.
+bool HeavierInfluence(const BoneInfluence &a, const BoneInfluence &b) {
+  return a.weight > b.weight;
+}
+
+inline float Dot(const Vector3d<float> &a, const Vector3d<float> &b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Simplifies a mesh one edge collapse at a time.
+class Simplifier {
+  public:
+    explicit Simplifier(const TriangleMesh &mesh);
+
+    // Collapses the cheapest edges until at most max_vertices are left, or
+    // no more edges can be collapsed.
+    void Simplify(int max_vertices);
+
+    inline int num_vertices() const { return num_vertices_; }
+
+    // Returns the largest error of any collapse so far.
+    inline float error() const { return std::sqrt(max_cost_); }
+
+    // Copies the current mesh into a new TriangleMesh.
+    TriangleMesh* Extract() const;
+
+  private:
+    // Costs collapsing the edge between v1 and v2, and queues it.
+    void QueueCollapse(int v1, int v2);
+
+    // Returns false if a collapse would change the mesh's topology or fold
+    // a triangle over.
+    bool CanCollapse(const Collapse &collapse);
+
+    void ApplyCollapse(const Collapse &collapse);
+
+    // Collects the vertices that share a live triangle with v.
+    void GetNeighbours(int v, std::vector<int> *neighbours) const;
+
+    // Drops the dead triangles from v's list.
+    void PruneTriangles(int v);
+
+    const TriangleMesh &mesh_;
+    int max_influences_;
+
+    std::vector<Vector3d<float> > positions_;
+    std::vector<Quadric> quadrics_;
+    std::vector<std::vector<BoneInfluence> > influences_;
+    std::vector<int> versions_;
+    std::vector<char> vertex_alive_;
+
+    // Three vertex indices per triangle, and the triangles around each
+    // vertex. The lists may hold triangles that have since died.
+    std::vector<int> triangles_;
+    std::vector<char> triangle_alive_;
+    std::vector<std::vector<int> > vertex_triangles_;
+
+    std::priority_queue<Collapse> queue_;
+    int num_vertices_;
+    double max_cost_;
+
+    // Scratch space for CanCollapse().
+    std::vector<int> neighbours1_;
+    std::vector<int> neighbours2_;
+};
+
+Simplifier::Simplifier(const TriangleMesh &mesh)
+    : mesh_(mesh), max_influences_(mesh.max_influences()),
+      num_vertices_(mesh.GetNumberOfVertices()), max_cost_(0.0) {
+  int num_triangles = mesh.GetNumberOfTriangles();
+  positions_.resize(num_vertices_);
+  quadrics_.resize(num_vertices_);
+  influences_.resize(num_vertices_);
+  versions_.assign(num_vertices_, 0);
+  vertex_alive_.assign(num_vertices_, true);
+  vertex_triangles_.resize(num_vertices_);
+  triangles_.resize(3 * num_triangles);
+  triangle_alive_.assign(num_triangles, true);
+
+  for (int v = 0; v < num_vertices_; v++) {
+    positions_[v] = mesh.GetVertex(v);
+    const BoneInfluence* influences = mesh.GetInfluences(v);
+    influences_[v].assign(influences,
+        influences + mesh.GetNumberOfInfluences(v));
+  }
+
+  // Each vertex starts with the planes of the triangles around it.
+  std::vector<Vector3d<float> > face_normals(num_triangles);
+  for (int t = 0; t < num_triangles; t++) {
+    int* corners = &triangles_[3 * t];
+    mesh.GetTriangle(t).GetVertexIndices(&corners[0], &corners[1],
+        &corners[2]);
+    Vector3d<float> normal = CrossProduct(
+        positions_[corners[1]] - positions_[corners[0]],
+        positions_[corners[2]] - positions_[corners[0]]);
+    normal.Normalize();
+    face_normals[t] = normal;
+
+    double d = -Dot(normal, positions_[corners[0]]);
+    for (int i = 0; i < 3; i++) {
+      quadrics_[corners[i]].AddPlane(normal[0], normal[1], normal[2], d, 1.0);
+      vertex_triangles_[corners[i]].push_back(t);
+    }
+  }
+
+  // Hold boundary edges in place with a plane through the edge,
+  // perpendicular to its triangle.
+  for (int e = 0; e < mesh.GetNumberOfEdges(); e++) {
+    const Edge &edge = mesh.GetEdge(e);
+    if (edge.NumberOfTriangles() != 1) {
+      continue;
+    }
+    const Vector3d<float> &p1 = positions_[edge.v1()];
+    Vector3d<float> normal = CrossProduct(p1 - positions_[edge.v2()],
+        face_normals[edge.triangle(0)]);
+    normal.Normalize();
+    double d = -Dot(normal, p1);
+    quadrics_[edge.v1()].AddPlane(normal[0], normal[1], normal[2], d,
+        kBoundaryWeight);
+    quadrics_[edge.v2()].AddPlane(normal[0], normal[1], normal[2], d,
+        kBoundaryWeight);
+  }
+
+  for (int e = 0; e < mesh.GetNumberOfEdges(); e++) {
+    QueueCollapse(mesh.GetEdge(e).v1(), mesh.GetEdge(e).v2());
+  }
+}
+
+void Simplifier::QueueCollapse(int v1, int v2) {
+  Quadric quadric = quadrics_[v1];
+  quadric += quadrics_[v2];
+
+  // Try either end and the middle of the edge. Keeping to the edge means
+  // the bone weights can be blended in the same proportions.
+  const float kCandidates[] = {0.0f, 0.5f, 1.0f};
+  Collapse collapse;
+  collapse.v1 = v1;
+  collapse.v2 = v2;
+  collapse.version1 = versions_[v1];
+  collapse.version2 = versions_[v2];
+  collapse.cost = -1.0;
+  for (int i = 0; i < 3; i++) {
+    float t = kCandidates[i];
+    Vector3d<float> target = positions_[v1];
+    target *= 1.0f - t;
+    Vector3d<float> end = positions_[v2];
+    end *= t;
+    target += end;
+
+    double cost = std::max(quadric.Evaluate(target), 0.0);
+    if (collapse.cost < 0.0 || cost < collapse.cost) {
+      collapse.cost = cost;
+      collapse.target = target;
+      collapse.t = t;
+    }
+  }
+  queue_.push(collapse);
+}
+
+void Simplifier::GetNeighbours(int v, std::vector<int> *neighbours) const {
+  neighbours->clear();
+  const std::vector<int> &triangles = vertex_triangles_[v];
+  for (unsigned int i = 0; i < triangles.size(); i++) {
+    if (!triangle_alive_[triangles[i]]) {
+      continue;
+    }
+    for (int j = 0; j < 3; j++) {
+      int other = triangles_[3 * triangles[i] + j];
+      if (other != v) {
+        neighbours->push_back(other);
+      }
+    }
+  }
+  std::sort(neighbours->begin(), neighbours->end());
+  neighbours->erase(std::unique(neighbours->begin(), neighbours->end()),
+      neighbours->end());
+}
+
+void Simplifier::PruneTriangles(int v) {
+  std::vector<int> &triangles = vertex_triangles_[v];
+  unsigned int live = 0;
+  for (unsigned int i = 0; i < triangles.size(); i++) {
+    if (triangle_alive_[triangles[i]]) {
+      triangles[live++] = triangles[i];
+    }
+  }
+  triangles.resize(live);
+}
+
+bool Simplifier::CanCollapse(const Collapse &collapse) {
+  int v1 = collapse.v1;
+  int v2 = collapse.v2;
+
+  // The link condition: the only vertices the two ends share must be the
+  // third corners of the triangles on the edge. Otherwise the collapse
+  // would pinch the surface.
+  int shared_triangles = 0;
+  PruneTriangles(v1);
+  const std::vector<int> &triangles1 = vertex_triangles_[v1];
+  for (unsigned int i = 0; i < triangles1.size(); i++) {
+    const int* corners = &triangles_[3 * triangles1[i]];
+    if (corners[0] == v2 || corners[1] == v2 || corners[2] == v2) {
+      shared_triangles++;
+    }
+  }
+  if (shared_triangles == 0) {
+    return false;
+  }
+
+  GetNeighbours(v1, &neighbours1_);
+  GetNeighbours(v2, &neighbours2_);
+  int shared_neighbours = 0;
+  for (unsigned int i = 0, j = 0;
+       i < neighbours1_.size() && j < neighbours2_.size();) {
+    if (neighbours1_[i] < neighbours2_[j]) {
+      i++;
+    } else if (neighbours1_[i] > neighbours2_[j]) {
+      j++;
+    } else {
+      shared_neighbours++;
+      i++;
+      j++;
+    }
+  }
+  if (shared_neighbours != shared_triangles) {
+    return false;
+  }
+
+  // No remaining triangle may flip over or become degenerate.
+  const int ends[] = {v1, v2};
+  for (int e = 0; e < 2; e++) {
+    PruneTriangles(ends[e]);
+    const std::vector<int> &triangles = vertex_triangles_[ends[e]];
+    for (unsigned int i = 0; i < triangles.size(); i++) {
+      const int* corners = &triangles_[3 * triangles[i]];
+      Vector3d<float> before[3];
+      Vector3d<float> after[3];
+      bool on_edge = false;
+      for (int j = 0; j < 3; j++) {
+        before[j] = positions_[corners[j]];
+        after[j] = before[j];
+        if (corners[j] == ends[e]) {
+          after[j] = collapse.target;
+        } else if (corners[j] == ends[1 - e]) {
+          on_edge = true;
+        }
+      }
+      if (on_edge) {
+        continue;
+      }
+
+      Vector3d<float> normal_before = CrossProduct(before[1] - before[0],
+          before[2] - before[0]);
+      Vector3d<float> normal_after = CrossProduct(after[1] - after[0],
+          after[2] - after[0]);
+      if (Dot(normal_before, normal_after) <= 0.0f) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void Simplifier::ApplyCollapse(const Collapse &collapse) {
+  int v1 = collapse.v1;
+  int v2 = collapse.v2;
+
+  positions_[v1] = collapse.target;
+  quadrics_[v1] += quadrics_[v2];
+  versions_[v1]++;
+
+  // Blend the bone weights, then keep only the heaviest, as LoadWeights()
+  // does.
+  std::vector<BoneInfluence> blended;
+  const std::vector<BoneInfluence>* sources[] = {
+      &influences_[v1], &influences_[v2]};
+  const float scales[] = {1.0f - collapse.t, collapse.t};
+  for (int s = 0; s < 2; s++) {
+    if (scales[s] == 0.0f) {
+      continue;
+    }
+    for (unsigned int i = 0; i < sources[s]->size(); i++) {
+      BoneInfluence influence = (*sources[s])[i];
+      influence.weight *= scales[s];
+      unsigned int j = 0;
+      while (j < blended.size() && blended[j].bone != influence.bone) {
+        j++;
+      }
+      if (j == blended.size()) {
+        blended.push_back(influence);
+      } else {
+        blended[j].weight += influence.weight;
+      }
+    }
+  }
+  std::sort(blended.begin(), blended.end(), HeavierInfluence);
+  if (static_cast<int>(blended.size()) > max_influences_) {
+    blended.resize(max_influences_);
+  }
+  float total_weight = 0.0f;
+  for (unsigned int i = 0; i < blended.size(); i++) {
+    total_weight += blended[i].weight;
+  }
+  for (unsigned int i = 0; i < blended.size(); i++) {
+    blended[i].weight /= total_weight;
+  }
+  influences_[v1].swap(blended);
+
+  // Move v2's triangles over to v1. The ones on the edge disappear.
+  std::vector<int> &triangles = vertex_triangles_[v2];
+  for (unsigned int i = 0; i < triangles.size(); i++) {
+    int t = triangles[i];
+    if (!triangle_alive_[t]) {
+      continue;
+    }
+    int* corners = &triangles_[3 * t];
+    if (corners[0] == v1 || corners[1] == v1 || corners[2] == v1) {
+      triangle_alive_[t] = false;
+      continue;
+    }
+    for (int j = 0; j < 3; j++) {
+      if (corners[j] == v2) {
+        corners[j] = v1;
+      }
+    }
+    vertex_triangles_[v1].push_back(t);
+  }
+  std::vector<int>().swap(triangles);
+  std::vector<BoneInfluence>().swap(influences_[v2]);
+  vertex_alive_[v2] = false;
+  num_vertices_--;
+
+  max_cost_ = std::max(max_cost_, collapse.cost);
+
+  // Recost the edges around v1. Those queued before are now stale.
+  PruneTriangles(v1);
+  GetNeighbours(v1, &neighbours1_);
+  for (unsigned int i = 0; i < neighbours1_.size(); i++) {
+    QueueCollapse(v1, neighbours1_[i]);
+  }
+}
+
+void Simplifier::Simplify(int max_vertices) {
+  while (num_vertices_ > max_vertices && !queue_.empty()) {
+    Collapse collapse = queue_.top();
+    queue_.pop();
+    if (!vertex_alive_[collapse.v1] || !vertex_alive_[collapse.v2] ||
+        versions_[collapse.v1] != collapse.version1 ||
+        versions_[collapse.v2] != collapse.version2) {
+      continue;
+    }
+    if (CanCollapse(collapse)) {
+      ApplyCollapse(collapse);
+    }
+  }
+}
+
+TriangleMesh* Simplifier::Extract() const {
+  // Keep the vertices that are still used, in their original order.
+  std::vector<int> new_index(positions_.size(), -1);
+  std::vector<int> triangle_vertices;
+  for (unsigned int t = 0; t < triangle_alive_.size(); t++) {
+    if (!triangle_alive_[t]) {
+      continue;
+    }
+    for (int i = 0; i < 3; i++) {
+      new_index[triangles_[3 * t + i]] = 0;
+    }
+  }
+
+  std::vector<Vector3d<float> > vertices;
+  std::vector<int> influence_offsets(1, 0);
+  std::vector<BoneInfluence> influences;
+  for (unsigned int v = 0; v < positions_.size(); v++) {
+    if (new_index[v] < 0) {
+      continue;
+    }
+    new_index[v] = vertices.size();
+    vertices.push_back(positions_[v]);
+    influences.insert(influences.end(), influences_[v].begin(),
+        influences_[v].end());
+    influence_offsets.push_back(influences.size());
+  }
+
+  for (unsigned int t = 0; t < triangle_alive_.size(); t++) {
+    if (triangle_alive_[t]) {
+      for (int i = 0; i < 3; i++) {
+        triangle_vertices.push_back(new_index[triangles_[3 * t + i]]);
+      }
+    }
+  }
+
+  TriangleMesh* mesh = new TriangleMesh();
+  mesh->SetMaxInfluences(max_influences_);
+  mesh->SetMesh(&vertices, triangle_vertices, &influence_offsets,
+      &influences);
+  mesh->SetSkeleton(*mesh_.skeleton());
+  if (mesh_.optimize_vertex_order()) {
+    mesh->SetOptimizeVertexOrder(true);
+    mesh->OptimizeVertexOrder(NULL, NULL);
+  }
+  return mesh;
+}
+}  // namespace
+
+LodChain::LodChain()
+    : size_(0.0f) {
+}
+
+LodChain::~LodChain() {
+  Clear();
+}
+
+void LodChain::Clear() {
+  for (unsigned int i = 1; i < levels_.size(); i++) {
+    delete levels_[i];
+  }
+  levels_.clear();
+  errors_.clear();
+}
+
+void LodChain::Build(const TriangleMesh &mesh, int num_levels,
+    float reduction) {
+  Clear();
+  levels_.push_back(&mesh);
+  errors_.push_back(0.0f);
+
+  size_ = 0.0f;
+  if (mesh.GetNumberOfVertices() > 0) {
+    Vector3d<float> low = mesh.GetVertex(0);
+    Vector3d<float> high = low;
+    for (int v = 1; v < mesh.GetNumberOfVertices(); v++) {
+      Vector3d<float> p = mesh.GetVertex(v);
+      for (int c = 0; c < 3; c++) {
+        low[c] = std::min(low[c], p[c]);
+        high[c] = std::max(high[c], p[c]);
+      }
+    }
+    for (int c = 0; c < 3; c++) {
+      size_ = std::max(size_, high[c] - low[c]);
+    }
+  }
+
+  if (num_levels < 2) {
+    return;
+  }
+
+  // Each level carries on collapsing from the one before.
+  Simplifier simplifier(mesh);
+  float target = mesh.GetNumberOfVertices();
+  for (int i = 1; i < num_levels; i++) {
+    target *= reduction;
+    int previous = simplifier.num_vertices();
+    simplifier.Simplify(static_cast<int>(target));
+    if (simplifier.num_vertices() == previous) {
+      break;
+    }
+    levels_.push_back(simplifier.Extract());
+    errors_.push_back(simplifier.error());
+  }
+}
+
+int LodChain::SelectByVertexBudget(int max_vertices) const {
+  for (int i = 0; i < num_levels(); i++) {
+    if (levels_[i]->GetNumberOfVertices() <= max_vertices) {
+      return i;
+    }
+  }
+  return num_levels() - 1;
+}
+
+int LodChain::SelectByScreenSize(float pixel_size,
+    float max_pixel_error) const {
+  if (size_ <= 0.0f) {
+    return 0;
+  }
+  int level = 0;
+  float pixels_per_unit = pixel_size / size_;
+  for (int i = 1; i < num_levels(); i++) {
+    if (errors_[i] * pixels_per_unit <= max_pixel_error) {
+      level = i;
+    }
+  }
+  return level;
+}
+}
@@ -0,0 +1,87 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_LOD_CHAIN_H_
+#define SRC_LOD_CHAIN_H_
+
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace computer_animation {
+
+//! \brief The default number of levels of detail built, including the
+//! original mesh.
+const int kDefaultLodLevels = 4;
+
+//! \brief The default fraction of the vertices kept from one level of
+//! detail to the next.
+const float kDefaultLodReduction = 0.5f;
+
+//! \class LodChain
+//! \brief A chain of progressively simpler versions of a skinned mesh.
+//!
+//! Level 0 is the original mesh. Each further level is made by collapsing
+//! edges of the original with Garland and Heckbert's quadric error metric,
+//! choosing the collapses that move the surface least first, until only a
+//! fraction of the vertices are left. The edges on the boundary of the
+//! mesh are held in place by extra planes through them.
+//!
+//! When an edge collapses, the bone weights of its two vertices are
+//! blended in the same proportions as their positions, so every level can
+//! be skinned with the original skeleton.
+class LodChain {
+  public:
+    LodChain();
+    ~LodChain();
+
+    //! \brief Builds the levels of detail for a mesh.
+    //!
+    //! Level i keeps about reduction^i of the mesh's vertices. Fewer than
+    //! num_levels levels are built if the mesh cannot be simplified that
+    //! far. The mesh is not copied, so must outlive the chain, and the
+    //! levels are given a copy of its skeleton.
+    void Build(const TriangleMesh &mesh, int num_levels, float reduction);
+
+    //! \brief Returns the number of levels, including the original mesh.
+    inline int num_levels() const { return levels_.size(); }
+
+    //! \brief Returns the i-th level of detail. Level 0 is the original
+    //! mesh.
+    inline const TriangleMesh& level(int i) const { return *levels_[i]; }
+
+    //! \brief Returns an estimate of the furthest any point on the i-th
+    //! level lies from the original surface, in model units.
+    inline float error(int i) const { return errors_[i]; }
+
+    //! \brief Returns the length of the longest side of the original mesh's
+    //! bounding box.
+    inline float size() const { return size_; }
+
+    //! \brief Returns the most detailed level with at most max_vertices
+    //! vertices, or the least detailed level if none are that small.
+    int SelectByVertexBudget(int max_vertices) const;
+
+    //! \brief Returns the least detailed level whose error would cover at
+    //! most max_pixel_error pixels, when the longest side of the mesh's
+    //! bounding box is drawn pixel_size pixels long.
+    int SelectByScreenSize(float pixel_size, float max_pixel_error) const;
+
+  private:
+    // Copying is not allowed.
+    LodChain(const LodChain&);
+    LodChain& operator=(const LodChain&);
+
+    // Deletes the levels built by Build().
+    void Clear();
+
+    // The levels of detail. The first is the original mesh, which is not
+    // owned by the chain.
+    std::vector<const TriangleMesh*> levels_;
+    std::vector<float> errors_;
+
+    // The length of the longest side of the original mesh's bounding box.
+    float size_;
+};
+}
+
+#endif  // SRC_LOD_CHAIN_H_
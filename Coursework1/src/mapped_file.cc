@@ -0,0 +1,57 @@
+//! \author Stephen McGruer
+
+#include "./mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace computer_animation {
+
+bool MappedFile::Open(const char *filename) {
+  Close();
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return false;
+  }
+
+  if (file_stat.st_size == 0) {
+    close(fd);
+    return true;
+  }
+
+  void *mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd,
+      0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const char*>(mapping);
+  size_ = file_stat.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != NULL) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+}
+
+void MappedFile::Swap(MappedFile *other) {
+  std::swap(data_, other->data_);
+  std::swap(size_, other->size_);
+}
+}
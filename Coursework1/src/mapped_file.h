@@ -0,0 +1,52 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_MAPPED_FILE_H_
+#define SRC_MAPPED_FILE_H_
+
+#include <cstddef>
+
+namespace computer_animation {
+
+//! \class MappedFile
+//! \brief A file mapped read-only into memory.
+//!
+//! The mapping is removed when the MappedFile is closed or destroyed, after
+//! which pointers into it must no longer be used.
+class MappedFile {
+  public:
+    MappedFile() : data_(NULL), size_(0) {
+    }
+
+    ~MappedFile() {
+      Close();
+    }
+
+    //! \brief Maps the named file, closing any file that was already open.
+    //!
+    //! Returns false if the file cannot be opened or mapped. An empty file
+    //! opens successfully, with a NULL data().
+    bool Open(const char *filename);
+
+    //! \brief Unmaps the file, if one is open.
+    void Close();
+
+    //! \brief Exchanges the mappings of two files.
+    void Swap(MappedFile *other);
+
+    //! \brief Returns the contents of the file.
+    inline const char* data() const { return data_; }
+
+    //! \brief Returns the size of the file, in bytes.
+    inline size_t size() const { return size_; }
+
+  private:
+    // Copying is not allowed.
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data_;
+    size_t size_;
+};
+}
+
+#endif  // SRC_MAPPED_FILE_H_
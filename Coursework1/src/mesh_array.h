@@ -0,0 +1,87 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_MESH_ARRAY_H_
+#define SRC_MESH_ARRAY_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "./array_view.h"
+
+namespace computer_animation {
+
+//! \class MeshArray
+//! \brief A read-only array of mesh data that either owns its elements or
+//! refers to elements stored elsewhere, such as in a mapped file.
+//!
+//! Copying an array that refers to elements elsewhere copies the reference,
+//! not the elements.
+template <typename T> class MeshArray {
+  public:
+    MeshArray() : data_(NULL), size_(0), borrowed_(false) {
+    }
+
+    MeshArray(const MeshArray &other)
+        : owned_(other.owned_), size_(other.size_),
+          borrowed_(other.borrowed_) {
+      data_ = borrowed_ ? other.data_ : owned_.data();
+    }
+
+    MeshArray& operator=(const MeshArray &other) {
+      owned_ = other.owned_;
+      size_ = other.size_;
+      borrowed_ = other.borrowed_;
+      data_ = borrowed_ ? other.data_ : owned_.data();
+      return *this;
+    }
+
+    //! \brief Takes the contents of elements, leaving it empty.
+    void Assign(std::vector<T> *elements) {
+      owned_.clear();
+      owned_.swap(*elements);
+      data_ = owned_.data();
+      size_ = owned_.size();
+      borrowed_ = false;
+    }
+
+    //! \brief Refers to size elements starting at data, which must outlive
+    //! the array.
+    void Borrow(const T* data, size_t size) {
+      std::vector<T>().swap(owned_);
+      data_ = data;
+      size_ = size;
+      borrowed_ = true;
+    }
+
+    //! \brief Empties the array.
+    void Clear() {
+      std::vector<T>().swap(owned_);
+      data_ = NULL;
+      size_ = 0;
+      borrowed_ = false;
+    }
+
+    //! \brief Returns the number of elements in the array.
+    inline size_t size() const { return size_; }
+
+    //! \brief Returns true if the array has no elements.
+    inline bool empty() const { return size_ == 0; }
+
+    //! \brief Returns a pointer to the first element.
+    inline const T* data() const { return data_; }
+
+    //! \brief Returns the i-th element. Does not perform bounds checking.
+    inline const T& operator[] (size_t i) const { return data_[i]; }
+
+    //! \brief Returns a view of the elements.
+    inline ArrayView<T> view() const { return ArrayView<T>(data_, size_); }
+
+  private:
+    std::vector<T> owned_;
+    const T* data_;
+    size_t size_;
+    bool borrowed_;
+};
+}
+
+#endif  // SRC_MESH_ARRAY_H_
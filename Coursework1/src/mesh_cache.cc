@@ -0,0 +1,59 @@
+//! \author Stephen McGruer
+
+#include "./mesh_cache.h"
+
+#include <cstring>
+
+#include "./mapped_file.h"
+
+namespace computer_animation {
+
+namespace {
+
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+// Adds a 64-bit word to an FNV-1a style hash.
+inline uint64_t HashWord(uint64_t hash, uint64_t word) {
+  return (hash ^ word) * kFnvPrime;
+}
+
+// Adds the contents of a file to a hash, eight bytes at a time. The file's
+// size is included so that trailing zero bytes still change the hash.
+bool HashFile(const char *filename, uint64_t *hash) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    return false;
+  }
+
+  const char* data = file.data();
+  size_t size = file.size();
+  uint64_t h = HashWord(*hash, size);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    h = HashWord(h, word);
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    memcpy(&word, data + i, size - i);
+    h = HashWord(h, word);
+  }
+
+  *hash = h;
+  return true;
+}
+}  // namespace
+
+bool HashMeshSources(const char *object_file, const char *weights_file,
+    int max_influences, bool optimize_vertex_order, uint64_t *hash) {
+  uint64_t h = kFnvOffsetBasis;
+  if (!HashFile(object_file, &h) || !HashFile(weights_file, &h)) {
+    return false;
+  }
+  h = HashWord(h, max_influences);
+  *hash = HashWord(h, optimize_vertex_order);
+  return true;
+}
+}
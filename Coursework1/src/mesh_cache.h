@@ -0,0 +1,72 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_MESH_CACHE_H_
+#define SRC_MESH_CACHE_H_
+
+#include <stdint.h>
+
+namespace computer_animation {
+
+//! \struct MeshCacheHeader
+//! \brief The header at the start of a mesh cache file.
+//!
+//! A mesh cache holds a TriangleMesh's vertices, normals, triangles, edges,
+//! bone influences and vertex-to-triangle index exactly as they are laid
+//! out in memory, so that the file can be mapped and used in place. Each
+//! section starts on a cache line boundary, at the offset given in the
+//! header. All values are stored in the machine's native byte order.
+//!
+//! The sections are:
+//!   vertices             num_vertices Vector3d<float>s.
+//!   normals              num_normals Vector3d<float>s.
+//!   triangles            num_triangles Triangles.
+//!   edges                num_edges Edges.
+//!   triangle edges       3 * num_triangles edge indices (ints).
+//!   influence offsets    num_vertices + 1 ints.
+//!   influences           num_influences BoneInfluences.
+//!   vertex face offsets  num_vertices + 1 ints.
+//!   vertex faces         num_vertex_faces triangle indices (ints).
+struct MeshCacheHeader {
+  char magic[4];  // Always "CAVM".
+  uint32_t version;
+
+  // The hash of the files the mesh was loaded from; see HashMeshSources.
+  uint64_t source_hash;
+
+  // The size of the whole file, in bytes.
+  uint64_t file_size;
+
+  uint32_t num_vertices;
+  uint32_t num_normals;
+  uint32_t num_triangles;
+  uint32_t num_edges;
+  uint32_t num_influences;
+  uint32_t num_vertex_faces;
+
+  // Byte offsets of the sections from the start of the file.
+  uint64_t vertices_offset;
+  uint64_t normals_offset;
+  uint64_t triangles_offset;
+  uint64_t edges_offset;
+  uint64_t triangle_edges_offset;
+  uint64_t influence_offsets_offset;
+  uint64_t influences_offset;
+  uint64_t vertex_face_offsets_offset;
+  uint64_t vertex_faces_offset;
+};
+
+//! \brief The current mesh cache version. Caches with any other version
+//! are regenerated.
+const uint32_t kMeshCacheVersion = 3;
+
+//! \brief Hashes the contents of an object file and a weights file,
+//! together with the maximum number of influences per vertex and whether
+//! the vertex order was optimized.
+//!
+//! A mesh cache is stale if this no longer matches its source_hash.
+//! Returns false if either file cannot be read.
+bool HashMeshSources(const char *object_file, const char *weights_file,
+    int max_influences, bool optimize_vertex_order, uint64_t *hash);
+}
+
+#endif  // SRC_MESH_CACHE_H_
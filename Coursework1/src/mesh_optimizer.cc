@@ -0,0 +1,197 @@
+//! \author Stephen McGruer
+
+#include "./mesh_optimizer.h"
+
+#include <cmath>
+
+namespace computer_animation {
+
+namespace {
+
+// Forsyth's scoring constants.
+const float kCacheDecayPower = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+// Valences above this all score the same.
+const int kMaxScoredValence = 32;
+
+// Precomputed vertex scores, by cache position and by the number of
+// triangles the vertex has left.
+class VertexScores {
+  public:
+    VertexScores() {
+      for (int i = 0; i < kVertexCacheSize; i++) {
+        if (i < 3) {
+          // The vertices of the last triangle are scored the same whatever
+          // order they were used in.
+          cache_[i] = kLastTriangleScore;
+        } else {
+          float scale = 1.0f / (kVertexCacheSize - 3);
+          cache_[i] = std::pow(1.0f - (i - 3) * scale, kCacheDecayPower);
+        }
+      }
+      valence_[0] = 0.0f;
+      for (int i = 1; i <= kMaxScoredValence; i++) {
+        valence_[i] = kValenceBoostScale * std::pow(static_cast<float>(i),
+            -kValenceBoostPower);
+      }
+    }
+
+    // Returns the score of a vertex at a cache position (or -1 if it is
+    // not in the cache) with remaining triangles left to draw.
+    float Score(int cache_position, int remaining) const {
+      if (remaining == 0) {
+        return -1.0f;
+      }
+      float score = (cache_position >= 0) ? cache_[cache_position] : 0.0f;
+      return score + valence_[(remaining < kMaxScoredValence) ?
+          remaining : kMaxScoredValence];
+    }
+
+  private:
+    float cache_[kVertexCacheSize];
+    float valence_[kMaxScoredValence + 1];
+};
+}  // namespace
+
+float ComputeAcmr(const int* indices, int num_triangles, int num_vertices) {
+  if (num_triangles == 0) {
+    return 0.0f;
+  }
+
+  // Each vertex remembers when it entered the cache; with a FIFO cache it
+  // is still there if fewer than kVertexCacheSize misses have happened
+  // since.
+  std::vector<int> entered(num_vertices, -kVertexCacheSize - 1);
+  int misses = 0;
+  for (int i = 0; i < 3 * num_triangles; i++) {
+    int vertex = indices[i];
+    if (misses - entered[vertex] > kVertexCacheSize) {
+      entered[vertex] = misses;
+      misses++;
+    }
+  }
+  return static_cast<float>(misses) / num_triangles;
+}
+
+void OptimizeTriangleOrder(const int* indices, int num_triangles,
+    int num_vertices, std::vector<int> *order) {
+  static const VertexScores scores;
+
+  order->clear();
+  order->reserve(num_triangles);
+
+  // Index the triangles around each vertex. The first remaining[v] entries
+  // for vertex v are the triangles it has left to draw.
+  std::vector<int> offsets(num_vertices + 1, 0);
+  for (int i = 0; i < 3 * num_triangles; i++) {
+    offsets[indices[i] + 1]++;
+  }
+  for (int i = 0; i < num_vertices; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<int> vertex_triangles(3 * num_triangles);
+  std::vector<int> remaining(num_vertices, 0);
+  for (int i = 0; i < 3 * num_triangles; i++) {
+    int vertex = indices[i];
+    vertex_triangles[offsets[vertex] + remaining[vertex]++] = i / 3;
+  }
+
+  std::vector<float> vertex_score(num_vertices);
+  for (int v = 0; v < num_vertices; v++) {
+    vertex_score[v] = scores.Score(-1, remaining[v]);
+  }
+
+  // Start from the best scoring triangle, which is one with the fewest
+  // neighbours.
+  std::vector<char> drawn(num_triangles, false);
+  int best = -1;
+  float best_score = -1.0f;
+  for (int t = 0; t < num_triangles; t++) {
+    float score = vertex_score[indices[3 * t]] +
+        vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+    if (score > best_score) {
+      best = t;
+      best_score = score;
+    }
+  }
+
+  // The simulated LRU cache, most recent first, with room for the three
+  // vertices that are pushed out when a triangle is added.
+  std::vector<int> cache;
+  std::vector<int> new_cache;
+  cache.reserve(kVertexCacheSize + 3);
+  new_cache.reserve(kVertexCacheSize + 3);
+
+  // Where to carry on looking for an undrawn triangle when none of the
+  // triangles around the cache are left.
+  int next_undrawn = 0;
+
+  while (static_cast<int>(order->size()) < num_triangles) {
+    if (best < 0) {
+      while (drawn[next_undrawn]) {
+        next_undrawn++;
+      }
+      best = next_undrawn;
+    }
+
+    order->push_back(best);
+    drawn[best] = true;
+
+    // Remove the triangle from its vertices' remaining triangles, and move
+    // the vertices to the front of the cache.
+    new_cache.clear();
+    for (int i = 0; i < 3; i++) {
+      int vertex = indices[3 * best + i];
+      int* triangles = &vertex_triangles[offsets[vertex]];
+      for (int j = 0; j < remaining[vertex]; j++) {
+        if (triangles[j] == best) {
+          triangles[j] = triangles[--remaining[vertex]];
+          break;
+        }
+      }
+      new_cache.push_back(vertex);
+    }
+    for (unsigned int i = 0; i < cache.size(); i++) {
+      int vertex = cache[i];
+      if (vertex != new_cache[0] && vertex != new_cache[1] &&
+          vertex != new_cache[2]) {
+        new_cache.push_back(vertex);
+      }
+    }
+    cache.swap(new_cache);
+
+    // Rescore the vertices that moved in the cache, including any that
+    // just fell out of it.
+    for (unsigned int i = 0; i < cache.size(); i++) {
+      int vertex = cache[i];
+      int position = (static_cast<int>(i) < kVertexCacheSize) ? i : -1;
+      vertex_score[vertex] = scores.Score(position, remaining[vertex]);
+    }
+
+    // Rescore their triangles, and pick the best of them to draw next.
+    best = -1;
+    best_score = -1.0f;
+    for (unsigned int i = 0; i < cache.size(); i++) {
+      int vertex = cache[i];
+      const int* triangles = &vertex_triangles[offsets[vertex]];
+      for (int j = 0; j < remaining[vertex]; j++) {
+        int t = triangles[j];
+        float score = vertex_score[indices[3 * t]] +
+            vertex_score[indices[3 * t + 1]] +
+            vertex_score[indices[3 * t + 2]];
+        if (score > best_score) {
+          best = t;
+          best_score = score;
+        }
+      }
+    }
+
+    if (static_cast<int>(cache.size()) > kVertexCacheSize) {
+      cache.resize(kVertexCacheSize);
+    }
+  }
+}
+}
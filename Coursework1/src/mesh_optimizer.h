@@ -0,0 +1,33 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_MESH_OPTIMIZER_H_
+#define SRC_MESH_OPTIMIZER_H_
+
+#include <vector>
+
+namespace computer_animation {
+
+//! \brief The number of vertices in the post-transform vertex cache that
+//! the optimizer targets, and that the ACMR is measured with.
+const int kVertexCacheSize = 32;
+
+//! \brief Returns the average cache miss ratio (ACMR) of a triangle list.
+//!
+//! This is the number of vertices that miss a FIFO vertex cache of
+//! kVertexCacheSize entries, divided by the number of triangles. It ranges
+//! from 3 (no reuse at all) down to about 0.5 for a regular grid.
+//! indices holds three vertex indices per triangle.
+float ComputeAcmr(const int* indices, int num_triangles, int num_vertices);
+
+//! \brief Finds an order of triangles with good vertex cache reuse.
+//!
+//! Uses Tom Forsyth's linear-speed vertex cache optimization: each vertex
+//! is scored on its position in a simulated LRU cache and on how many of
+//! its triangles are left, and the highest scoring triangle next to the
+//! cache is drawn next. Fills order with the indices of the triangles in
+//! their new order.
+void OptimizeTriangleOrder(const int* indices, int num_triangles,
+    int num_vertices, std::vector<int> *order);
+}
+
+#endif  // SRC_MESH_OPTIMIZER_H_
@@ -0,0 +1,161 @@
+//! \author Stephen McGruer
+
+// Buffer objects are core OpenGL 1.5, but the system headers only declare
+// functions past 1.3 with this defined.
+#define GL_GLEXT_PROTOTYPES
+
+#include "./mesh_renderer.h"
+
+#include <GL/glext.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace computer_animation {
+
+namespace {
+
+// The skin colour, set once per draw rather than per vertex.
+const GLfloat kSkinColor[] = {0.8, 0.1, 0.1, 1.0};
+
+// Returns true if the current context is at least OpenGL 1.5.
+bool HasBufferObjects() {
+  const char* version =
+      reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int major = 0;
+  int minor = 0;
+  if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2) {
+    return false;
+  }
+  return major > 1 || (major == 1 && minor >= 5);
+}
+}  // namespace
+
+MeshRenderer::MeshRenderer()
+    : num_vertices_(0), num_indices_(0), uses_buffer_objects_(false),
+      vertex_buffer_(0), index_buffer_(0) {
+}
+
+void MeshRenderer::Init(const TriangleMesh &mesh) {
+  num_vertices_ = mesh.GetNumberOfVertices();
+  num_indices_ = 3 * mesh.GetNumberOfTriangles();
+
+  indices_.resize(num_indices_);
+  for (int t = 0; t < mesh.GetNumberOfTriangles(); t++) {
+    int v1, v2, v3;
+    mesh.GetTriangle(t).GetVertexIndices(&v1, &v2, &v3);
+    indices_[3 * t] = v1;
+    indices_[3 * t + 1] = v2;
+    indices_[3 * t + 2] = v3;
+  }
+
+  uses_buffer_objects_ = HasBufferObjects();
+  if (!uses_buffer_objects_) {
+    vertices_.resize(6 * num_vertices_);
+    quantized_vertices_.resize(6 * num_vertices_);
+    return;
+  }
+
+  if (index_buffer_ == 0) {
+    glGenBuffers(1, &index_buffer_);
+    glGenBuffers(1, &vertex_buffer_);
+  }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices_ * sizeof(GLuint),
+      indices_.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  // The indices now live on the GPU.
+  std::vector<GLuint>().swap(indices_);
+}
+
+void MeshRenderer::Draw(const float* positions, const float* normals) {
+  DrawVertices(positions, normals, GL_FLOAT, &vertices_);
+}
+
+void MeshRenderer::DrawQuantized(const int16_t* positions,
+    const int16_t* normals, const float* position_offset,
+    float position_scale) {
+  // The scale is the same on every axis, so only the normals' lengths
+  // change, which GL_NORMALIZE puts right.
+  glPushAttrib(GL_ENABLE_BIT);
+  glEnable(GL_NORMALIZE);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glTranslatef(position_offset[0], position_offset[1], position_offset[2]);
+  glScalef(position_scale, position_scale, position_scale);
+
+  DrawVertices(positions, normals, GL_SHORT, &quantized_vertices_);
+
+  glPopMatrix();
+  glPopAttrib();
+}
+
+template <typename T> void MeshRenderer::DrawVertices(const T* positions,
+    const T* normals, GLenum type, std::vector<T> *client_vertices) {
+  glMaterialfv(GL_FRONT, GL_DIFFUSE, kSkinColor);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+
+  if (uses_buffer_objects_) {
+    GLsizeiptr size = 6 * num_vertices_ * sizeof(T);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+
+    // Orphan the old storage, then fill the new storage in place.
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    T* vertices = static_cast<T*>(
+        glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+    bool filled = false;
+    if (vertices != NULL) {
+      FillVertices(positions, normals, vertices);
+      // The contents are lost if unmapping fails.
+      filled = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+    }
+    if (!filled) {
+      // The buffer could not be mapped, so fill it from client memory.
+      client_vertices->resize(6 * num_vertices_);
+      FillVertices(positions, normals, client_vertices->data());
+      glBufferSubData(GL_ARRAY_BUFFER, 0, size, client_vertices->data());
+    }
+
+    glVertexPointer(3, type, 0, NULL);
+    glNormalPointer(type, 0,
+        reinterpret_cast<const GLvoid*>(3 * num_vertices_ * sizeof(T)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_INT, NULL);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  } else {
+    FillVertices(positions, normals, client_vertices->data());
+    glVertexPointer(3, type, 0, client_vertices->data());
+    glNormalPointer(type, 0, client_vertices->data() + 3 * num_vertices_);
+    glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_INT,
+        indices_.data());
+  }
+
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void MeshRenderer::FillVertices(const float* positions, const float* normals,
+    float* vertices) const {
+  int count = 3 * num_vertices_;
+  memcpy(vertices, positions, count * sizeof(float));
+  float* out_normals = vertices + count;
+  for (int i = 0; i < count; i++) {
+    out_normals[i] = -normals[i];
+  }
+}
+
+void MeshRenderer::FillVertices(const int16_t* positions,
+    const int16_t* normals, int16_t* vertices) const {
+  // Quantized normals are never -32768, so negating them cannot overflow.
+  int count = 3 * num_vertices_;
+  memcpy(vertices, positions, count * sizeof(int16_t));
+  int16_t* out_normals = vertices + count;
+  for (int i = 0; i < count; i++) {
+    out_normals[i] = -normals[i];
+  }
+}
+}
@@ -0,0 +1,92 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_MESH_RENDERER_H_
+#define SRC_MESH_RENDERER_H_
+
+#include <GL/gl.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace computer_animation {
+
+//! \class MeshRenderer
+//! \brief Draws a deforming TriangleMesh with OpenGL.
+//!
+//! The triangle indices are uploaded to an index buffer once. Every frame,
+//! the vertex buffer is orphaned and the skinned positions and normals are
+//! written into fresh storage through a mapping, so the driver never has to
+//! wait for the previous frame's draw to finish with the old contents. The
+//! mesh is then drawn with a single glDrawElements call.
+//!
+//! Only OpenGL 1.5 buffer objects and the fixed-function pipeline are used,
+//! so this runs on Mesa's software renderers. If buffer objects are not
+//! available, the same arrays are drawn from client memory instead.
+class MeshRenderer {
+  public:
+    MeshRenderer();
+
+    //! \brief Prepares to draw a mesh. Needs a current OpenGL context.
+    //!
+    //! Must be called again if the mesh's triangles change. The buffers
+    //! are not freed until the context is destroyed.
+    void Init(const TriangleMesh &mesh);
+
+    //! \brief Draws the mesh with the given vertex positions and normals,
+    //! each (x, y, z) triples with one per mesh vertex.
+    //!
+    //! The normals are flipped as they are uploaded, as the mesh's normals
+    //! point inwards.
+    void Draw(const float* positions, const float* normals);
+
+    //! \brief Draws the mesh with quantized vertex positions and normals,
+    //! each (x, y, z) triples of 16-bit values with one per mesh vertex,
+    //! as stored in a VertexCache.
+    //!
+    //! Position coordinate c of a value q is position_offset[c] + q *
+    //! position_scale; the renderer applies this with the modelview matrix,
+    //! so the values are uploaded as they are. Normals are scaled to unit
+    //! length by OpenGL. This is used to play back baked animations.
+    void DrawQuantized(const int16_t* positions, const int16_t* normals,
+        const float* position_offset, float position_scale);
+
+    //! \brief Returns true if the mesh is drawn from buffer objects, false
+    //! if from client memory.
+    inline bool uses_buffer_objects() const { return uses_buffer_objects_; }
+
+  private:
+    // Copying is not allowed.
+    MeshRenderer(const MeshRenderer&);
+    MeshRenderer& operator=(const MeshRenderer&);
+
+    // Writes the positions and flipped normals into vertices, positions
+    // first.
+    void FillVertices(const float* positions, const float* normals,
+        float* vertices) const;
+    void FillVertices(const int16_t* positions, const int16_t* normals,
+        int16_t* vertices) const;
+
+    // Fills the vertex buffer, or client_vertices if buffer objects are not
+    // available, with the positions and flipped normals, each coordinate a
+    // T of the given OpenGL type, and draws the triangles. If the vertex
+    // buffer cannot be mapped, it is filled from client_vertices instead.
+    template <typename T> void DrawVertices(const T* positions,
+        const T* normals, GLenum type, std::vector<T> *client_vertices);
+
+    int num_vertices_;
+    int num_indices_;
+    bool uses_buffer_objects_;
+    GLuint vertex_buffer_;
+    GLuint index_buffer_;
+
+    // Client memory copies, used when buffer objects are not available or
+    // the vertex buffer cannot be mapped.
+    std::vector<GLuint> indices_;
+    std::vector<float> vertices_;
+    std::vector<int16_t> quantized_vertices_;
+};
+}
+
+#endif  // SRC_MESH_RENDERER_H_
@@ -0,0 +1,319 @@
+//! \author Stephen McGruer
+
+#include "./obj_parser.h"
+
+#include <cstring>
+
+#include "./mapped_file.h"
+
+namespace computer_animation {
+
+namespace {
+
+// Files are split into chunks of roughly this many bytes, so that there is
+// enough work to spread between threads without too many partial results.
+const size_t kChunkBytes = 1 << 20;
+
+// Powers of ten for scaling the parsed mantissa.
+const double kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+const int kMaxPowerOfTen = 22;
+
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Skips spaces and tabs, but not newlines.
+inline const char* SkipSpaces(const char *p, const char *end) {
+  while (p < end && IsSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+// Skips to the start of the next line.
+inline const char* SkipLine(const char *p, const char *end) {
+  while (p < end && *p != '\n') {
+    p++;
+  }
+  return (p < end) ? p + 1 : end;
+}
+
+// Parses an integer. Returns the position after it, or NULL if there is
+// no integer at p.
+const char* ParseInt(const char *p, const char *end, int *value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    p++;
+  }
+  if (p >= end || !IsDigit(*p)) {
+    return NULL;
+  }
+
+  int result = 0;
+  while (p < end && IsDigit(*p)) {
+    result = result * 10 + (*p - '0');
+    p++;
+  }
+  *value = negative ? -result : result;
+  return p;
+}
+
+// Parses a decimal floating point number, with an optional exponent.
+// Returns the position after it, or NULL if there is no number at p.
+const char* ParseFloat(const char *p, const char *end, float *value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    p++;
+  }
+
+  // Gather up to 19 significant digits into an integer mantissa; any
+  // further digits only affect the exponent.
+  unsigned long long mantissa = 0;
+  int significant_digits = 0;
+  int exponent = 0;
+  bool any_digits = false;
+  while (p < end && IsDigit(*p)) {
+    if (significant_digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) {
+        significant_digits++;
+      }
+    } else {
+      exponent++;
+    }
+    any_digits = true;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && IsDigit(*p)) {
+      if (significant_digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) {
+          significant_digits++;
+        }
+        exponent--;
+      }
+      any_digits = true;
+      p++;
+    }
+  }
+  if (!any_digits) {
+    return NULL;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int exponent_value;
+    const char *after = ParseInt(p + 1, end, &exponent_value);
+    if (after != NULL) {
+      exponent += exponent_value;
+      p = after;
+    }
+  }
+
+  double result = static_cast<double>(mantissa);
+  while (exponent > kMaxPowerOfTen) {
+    result *= kPowersOfTen[kMaxPowerOfTen];
+    exponent -= kMaxPowerOfTen;
+  }
+  while (exponent < -kMaxPowerOfTen) {
+    result /= kPowersOfTen[kMaxPowerOfTen];
+    exponent += kMaxPowerOfTen;
+  }
+  result = (exponent >= 0) ? result * kPowersOfTen[exponent] :
+      result / kPowersOfTen[-exponent];
+
+  *value = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+// Parses three floats into a vector. Missing values are left as zero.
+const char* ParseVector(const char *p, const char *end,
+    Vector3d<float> *vector) {
+  for (int i = 0; i < 3; i++) {
+    p = SkipSpaces(p, end);
+    float value;
+    const char *after = ParseFloat(p, end, &value);
+    if (after == NULL) {
+      break;
+    }
+    (*vector)[i] = value;
+    p = after;
+  }
+  return p;
+}
+
+// Parses the vertices of an 'f' line and adds them to data as a fan of
+// triangles.
+void ParseFace(const char *p, const char *end, ObjData *data) {
+  int first_vertex = -1;
+  int first_normal = -1;
+  int previous_vertex = -1;
+  int previous_normal = -1;
+  int count = 0;
+
+  while (true) {
+    p = SkipSpaces(p, end);
+    int vertex;
+    const char *after = ParseInt(p, end, &vertex);
+    if (after == NULL) {
+      break;
+    }
+    p = after;
+
+    // Skip the texture coordinate and read the normal, if present.
+    int normal = 0;
+    if (p < end && *p == '/') {
+      p++;
+      int texture;
+      after = ParseInt(p, end, &texture);
+      p = (after == NULL) ? p : after;
+      if (p < end && *p == '/') {
+        p++;
+        after = ParseInt(p, end, &normal);
+        p = (after == NULL) ? p : after;
+      }
+    }
+
+    // Object file indices start from 1.
+    vertex--;
+    normal--;
+
+    if (count == 0) {
+      first_vertex = vertex;
+      first_normal = normal;
+    } else if (count >= 2) {
+      data->triangle_vertices.push_back(first_vertex);
+      data->triangle_vertices.push_back(previous_vertex);
+      data->triangle_vertices.push_back(vertex);
+      data->triangle_normals.push_back(first_normal);
+      data->triangle_normals.push_back(previous_normal);
+      data->triangle_normals.push_back(normal);
+    }
+    previous_vertex = vertex;
+    previous_normal = normal;
+    count++;
+  }
+}
+
+// Parses every line in [begin, end), which must start at the beginning of
+// a line.
+void ParseChunk(const char *begin, const char *end, ObjData *data) {
+  const char *p = begin;
+  while (p < end) {
+    p = SkipSpaces(p, end);
+    if (p + 1 < end && p[0] == 'v' && IsSpace(p[1])) {
+      Vector3d<float> vertex;
+      p = ParseVector(p + 2, end, &vertex);
+      data->vertices.push_back(vertex);
+    } else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+      Vector3d<float> normal;
+      p = ParseVector(p + 3, end, &normal);
+      data->normals.push_back(normal);
+    } else if (p + 1 < end && p[0] == 'f' && IsSpace(p[1])) {
+      ParseFace(p + 2, end, data);
+    }
+    p = SkipLine(p, end);
+  }
+}
+
+// Parses the chunks of a file, each into its own ObjData.
+class ParseTask : public ParallelTask {
+  public:
+    ParseTask(const std::vector<const char*> &chunk_starts,
+        std::vector<ObjData> *results)
+        : chunk_starts_(chunk_starts), results_(results) {
+    }
+
+    void Run(int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        ParseChunk(chunk_starts_[i], chunk_starts_[i + 1], &(*results_)[i]);
+      }
+    }
+
+  private:
+    const std::vector<const char*> &chunk_starts_;
+    std::vector<ObjData>* results_;
+};
+
+// Appends the contents of one vector to another.
+template <typename T> void Append(const std::vector<T> &from,
+    std::vector<T> *to) {
+  to->insert(to->end(), from.begin(), from.end());
+}
+}  // namespace
+
+bool ParseObjFile(const char *filename, ThreadPool *pool, ObjData *data) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    return false;
+  }
+
+  *data = ObjData();
+  if (file.size() == 0) {
+    return true;
+  }
+
+  const char *begin = file.data();
+  const char *end = begin + file.size();
+
+  // Split the file into chunks, moving each boundary forward to the start
+  // of the next line.
+  std::vector<const char*> chunk_starts;
+  chunk_starts.push_back(begin);
+  const char *p = begin + kChunkBytes;
+  while (p < end) {
+    const char *newline =
+        static_cast<const char*>(memchr(p, '\n', end - p));
+    if (newline == NULL) {
+      break;
+    }
+    chunk_starts.push_back(newline + 1);
+    p = newline + 1 + kChunkBytes;
+  }
+  if (chunk_starts.back() != end) {
+    chunk_starts.push_back(end);
+  }
+  int num_chunks = chunk_starts.size() - 1;
+
+  std::vector<ObjData> results(num_chunks);
+  ParseTask task(chunk_starts, &results);
+  pool->ParallelFor(&task, 0, num_chunks, 1);
+  file.Close();
+
+  // Join the chunks back together in file order.
+  if (num_chunks == 1) {
+    *data = results[0];
+    return true;
+  }
+
+  size_t num_vertices = 0;
+  size_t num_normals = 0;
+  size_t num_indices = 0;
+  for (int i = 0; i < num_chunks; i++) {
+    num_vertices += results[i].vertices.size();
+    num_normals += results[i].normals.size();
+    num_indices += results[i].triangle_vertices.size();
+  }
+  data->vertices.reserve(num_vertices);
+  data->normals.reserve(num_normals);
+  data->triangle_vertices.reserve(num_indices);
+  data->triangle_normals.reserve(num_indices);
+  for (int i = 0; i < num_chunks; i++) {
+    Append(results[i].vertices, &data->vertices);
+    Append(results[i].normals, &data->normals);
+    Append(results[i].triangle_vertices, &data->triangle_vertices);
+    Append(results[i].triangle_normals, &data->triangle_normals);
+  }
+
+  return true;
+}
+}
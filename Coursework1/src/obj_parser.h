@@ -0,0 +1,43 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_OBJ_PARSER_H_
+#define SRC_OBJ_PARSER_H_
+
+#include <vector>
+
+#include "./thread_pool.h"
+#include "./vector3d-inl.h"
+
+namespace computer_animation {
+
+//! \struct ObjData
+//! \brief The geometry read from an object file.
+//!
+//! Indices are 0-based. Polygons with more than three vertices are split
+//! into a fan of triangles.
+struct ObjData {
+  std::vector<Vector3d<float> > vertices;
+  std::vector<Vector3d<float> > normals;
+
+  // Three vertex indices per triangle.
+  std::vector<int> triangle_vertices;
+
+  // Three normal indices per triangle, or -1 where the face did not give
+  // a normal.
+  std::vector<int> triangle_normals;
+};
+
+//! \brief Reads an object file.
+//!
+//! The file is memory-mapped and split into chunks at line boundaries,
+//! which are parsed in parallel on the given pool and then joined back
+//! together in file order. Supports 'v', 'vn' and 'f' lines, with face
+//! vertices given as v, v/vt, v//vn or v/vt/vn. Texture coordinates are
+//! skipped, as are all other kinds of line. Negative (relative) indices are
+//! not supported.
+//!
+//! Returns false if the file cannot be read.
+bool ParseObjFile(const char *filename, ThreadPool *pool, ObjData *data);
+}
+
+#endif  // SRC_OBJ_PARSER_H_
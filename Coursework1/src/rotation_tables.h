@@ -0,0 +1,69 @@
+//! \author Stephen McGruer
+
+// Sine and cosine tables for whole numbers of degrees, generated at compile
+// time. Bone rotations are stored as integer degrees, so these let forward
+// kinematics build rotation matrices without calling sin() or cos().
+
+#ifndef SRC_ROTATION_TABLES_H_
+#define SRC_ROTATION_TABLES_H_
+
+namespace computer_animation {
+
+//! \struct TrigTable
+//! \brief The sine and cosine of every whole degree in [0, 360).
+struct TrigTable {
+  float sin[360];
+  float cos[360];
+};
+
+//! \brief Calculates sin(x) for x in [-pi, pi] from its Taylor series.
+//!
+//! Only intended for use at compile time; use std::sin at runtime.
+constexpr double TaylorSin(double x) {
+  double term = x;
+  double sum = x;
+  // The terms shrink factorially, so 20 is far more than double needs on
+  // [-pi, pi].
+  for (int n = 1; n < 20; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+//! \brief Builds the table of sines and cosines.
+constexpr TrigTable MakeTrigTable() {
+  const double kPi = 3.14159265358979323846;
+  TrigTable table = {};
+  for (int degrees = 0; degrees < 360; degrees++) {
+    // Work in [-180, 180) so that the Taylor series stays accurate.
+    int wrapped = (degrees >= 180) ? degrees - 360 : degrees;
+    int cos_wrapped = (wrapped + 90 >= 180) ? wrapped - 270 : wrapped + 90;
+    table.sin[degrees] = static_cast<float>(TaylorSin(wrapped * kPi / 180));
+    table.cos[degrees] =
+        static_cast<float>(TaylorSin(cos_wrapped * kPi / 180));
+  }
+  return table;
+}
+
+//! \brief The sine and cosine of every whole degree in [0, 360).
+constexpr TrigTable kTrigTable = MakeTrigTable();
+
+//! \brief Returns the table index for an angle in degrees.
+inline int TrigTableIndex(int degrees) {
+  int index = degrees % 360;
+  return (index < 0) ? index + 360 : index;
+}
+
+//! \brief Returns the sine of an angle given in whole degrees.
+inline float SinDegrees(int degrees) {
+  return kTrigTable.sin[TrigTableIndex(degrees)];
+}
+
+//! \brief Returns the cosine of an angle given in whole degrees.
+inline float CosDegrees(int degrees) {
+  return kTrigTable.cos[TrigTableIndex(degrees)];
+}
+}
+
+#endif  // SRC_ROTATION_TABLES_H_
@@ -1,95 +1,122 @@
 //! \author Stephen McGruer
 
 #include <cstdio>
-#include <limits>
 
 #include "./cav_utils.h"
 #include "./skeleton.h"
 
 namespace computer_animation {
 
-// This function is currently incomplete, as I cannot figure out how to
-// determine the rotations necessary to move the end effector from it's
-// current position to the closest point on the sphere to the target.
-// Without this ability, it's still possible to move the end effector,
-// but not to update any intermediate bones positions - this means that
-// not only will the skeleton be wrong, running more iterations of CCD
-// doesn't even make sense. (As the distances between the end effector
-// and each parent/grandparent/... bone has changed.)
-//
-// If you press ']' when running the program, you can see it attempt to
-// move a foot, and observe the output in the terminal for one iteration.
-void Skeleton::CCDMoveBoneTo(int i, Vector3d<float> target_position) {
-  fprintf(stdout, "CCD:\n");
-  fprintf(stdout, "Initial target: (%f, %f, %f)\n\n", target_position[0],
-      target_position[1], target_position[2]);
-
-  float distance_to_target = std::numeric_limits<float>::infinity();
-
-  // CCD is performed a maximum of kMaxCCDIterations times - if the target
-  // cannot be reached after this then we give up.
-  int iteration = 0;
-  while (distance_to_target > kCCDDistanceThreshold &&
-      iteration++ < kMaxCCDIterations) {
-    // For each bone up to the root, move the bone so that the end effector
-    // is as close as possible to the target point.
-    const Bone* current_bone =  bones_.at(i).Parent();
-    while (current_bone != NULL) {
-      const Vector3d<float> sphere_centre = current_bone->CurrentPosition();
-      fprintf(stdout, "Sphere Centre: (%f, %f, %f)\n", sphere_centre[0],
-          sphere_centre[1], sphere_centre[2]);
-
-      Vector3d<float> effector_position = bones_.at(i).CurrentPosition();
-
-      fprintf(stdout, "Effector Position (before): (%f, %f, %f)\n",
-          effector_position[0], effector_position[1], effector_position[2]);
-
-      float sphere_radius = sphere_centre.DistanceTo(effector_position);
-
-      fprintf(stdout, "Radius: %f\n", sphere_radius);
-
-      // Find the line from the sphere centre to the target.
-      Vector3d<float> line_delta = (target_position - sphere_centre);
-      float line_distance = sphere_centre.DistanceTo(target_position);
-      line_delta /= line_distance;
-
-      // Now calculate the closest position on the sphere to the target
-      // position.
-      line_delta *= sphere_radius;
-      Vector3d<float> sphere_target = sphere_centre + line_delta;
-      Vector3d<float> sphere_target_2 = sphere_centre - line_delta;
-
-      fprintf(stdout, "Sphere target: (%f, %f, %f)\n", sphere_target[0],
-          sphere_target[1], sphere_target[2]);
-      fprintf(stdout, "Sphere target2: (%f, %f, %f)\n", sphere_target_2[0],
-          sphere_target_2[1], sphere_target_2[2]);
-
-      // Move the bone directly to sphere_target.
-      bones_.at(i).SetPosition(sphere_target);
-
-      effector_position = bones_.at(i).CurrentPosition();
-      fprintf(stdout, "Effector Position (after): (%f, %f, %f)\n\n",
-          effector_position[0], effector_position[1], effector_position[2]);
-
-      current_bone = current_bone->Parent();
+namespace {
+
+// Calculates a bone's contribution to its M matrix: the R and T matrices
+// for the bone alone, so that the full M matrix is the parent's M
+// multiplied by this one.
+void CalculateLocalM(const Vector3d<int> &rotation,
+    const Vector3d<float> &position, const Vector3d<float> &parent_position,
+    Matrix4x4 *f) {
+  // Rotations are carried out around the x-axis first, then the y-axis,
+  // and finally around the z-axis.
+  Matrix3x3 r;
+  CreateXYZRotMatrix(&r, rotation);
+
+  // R * T is the rotation with a translation of R * t.
+  Vector3d<float> translation = position - parent_position;
+  for (int row = 0; row < 3; row++) {
+    (*f)(row, 0) = r(row, 0);
+    (*f)(row, 1) = r(row, 1);
+    (*f)(row, 2) = r(row, 2);
+    (*f)(row, 3) = r(row, 0) * translation[0] + r(row, 1) * translation[1] +
+        r(row, 2) * translation[2];
+  }
+  (*f)(3, 0) = 0.0f;
+  (*f)(3, 1) = 0.0f;
+  (*f)(3, 2) = 0.0f;
+  (*f)(3, 3) = 1.0f;
+}
+}  // namespace
+
+Skeleton::Skeleton()
+    : transforms_valid_(false),
+      any_bone_changed_(false) {
+}
+
+bool Skeleton::Load(const char *filename) {
+  FILE *f;
+  f = fopen(filename, "r");
+
+  if (f == NULL) {
+    fprintf(stderr, "Error: Failed reading skeleton file %s\n", filename);
+    return false;
+  }
+
+  char buf[1024];
+  int id;
+  float x, y, z;
+  int parent;
+
+  // Bones are placed by number, so the lines may come in any order.
+  std::vector<Vector3d<float> > rest_positions;
+  std::vector<int> parent_indices;
+  std::vector<char> seen;
+  bool valid = true;
+  int line = 0;
+  while (valid && fgets(buf, sizeof(buf), f) != NULL) {
+    line++;
+    char blank[2];
+    if (sscanf(buf, "%1s", blank) != 1) {
+      continue;
+    }
+
+    // This is safe as buf is a bounded-size input.
+    if (sscanf(buf, "%d %f %f %f %d", &id, &x, &y, &z, &parent) != 5 ||
+        id < 0) {
+      fprintf(stderr, "Error: Malformed bone on line %d of skeleton file "
+          "%s\n", line, filename);
+      valid = false;
+    } else if (parent >= id || parent < -1) {
+      fprintf(stderr, "Error: Bone %d in skeleton file %s must be numbered "
+          "after its parent %d\n", id, filename, parent);
+      valid = false;
+    } else {
+      if (id >= static_cast<int>(seen.size())) {
+        rest_positions.resize(id + 1);
+        parent_indices.resize(id + 1);
+        seen.resize(id + 1, false);
+      }
+      if (seen[id]) {
+        fprintf(stderr, "Error: Bone %d is given twice in skeleton file "
+            "%s\n", id, filename);
+        valid = false;
+      }
+      seen[id] = true;
+      rest_positions[id] = Vector3d<float>(x, y, z);
+      parent_indices[id] = parent;
     }
   }
+  fclose(f);
 
-  if (iteration > kMaxCCDIterations) {
-    fprintf(stdout, "Max number of iterations reached.\n");
+  for (unsigned int i = 0; valid && i < seen.size(); i++) {
+    if (!seen[i]) {
+      fprintf(stderr, "Error: Bone %d is missing from skeleton file %s\n",
+          i, filename);
+      valid = false;
+    }
+  }
+  if (valid && seen.empty()) {
+    fprintf(stderr, "Error: Skeleton file %s has no bones\n", filename);
+    valid = false;
+  }
+  if (!valid) {
+    return false;
   }
 
-  Bone end_effector = bones_.at(i);
-  Vector3d<float> effector_position = end_effector.CurrentPosition();
-  fprintf(stdout, "End Effector Final Position: (%f, %f, %f)\n",
-      effector_position[0], effector_position[1], effector_position[2]);
+  SetBones(rest_positions, parent_indices);
+  return true;
 }
 
 void Skeleton::AdjustBoneRotation(int i, Vector3d<int> delta_rotation) {
-  Bone* bone = &bones_.at(i);
-  Vector3d<int> current_rotation = bone->Rotation();
-
-  bone->SetRotation(current_rotation + delta_rotation);
+  SetRotation(i, rotations_.at(i) + delta_rotation);
 }
 
 Skeleton& Skeleton::operator=(const Skeleton &rhs) {
@@ -97,28 +124,21 @@ Skeleton& Skeleton::operator=(const Skeleton &rhs) {
     return *this;
   }
 
-  std::vector<Bone>::iterator this_it = bones_.begin();
-  std::vector<Bone>::const_iterator rhs_it = rhs.bones_.begin();
-
-  while (this_it != bones_.end()) {
-    *this_it = *rhs_it;
-
-    this_it++;
-    rhs_it++;
+  if (parent_indices_ != rhs.parent_indices_ ||
+      rest_positions_ != rhs.rest_positions_) {
+    SetBones(rhs.rest_positions_, rhs.parent_indices_);
   }
+  positions_ = rhs.positions_;
+  rotations_ = rhs.rotations_;
 
   return *this;
 }
 
 Skeleton& Skeleton::operator-=(const Skeleton &rhs) {
-  std::vector<Bone>::iterator this_it = bones_.begin();
-  std::vector<Bone>::const_iterator rhs_it = rhs.bones_.begin();
-
-  while (this_it != bones_.end()) {
-    *this_it -= *rhs_it;
-
-    this_it++;
-    rhs_it++;
+  int num_bones = GetNumberBones();
+  for (int i = 0; i < num_bones; i++) {
+    positions_[i] -= rhs.positions_[i];
+    rotations_[i] -= rhs.rotations_[i];
   }
 
   return *this;
@@ -130,58 +150,81 @@ const Skeleton Skeleton::operator-(const Skeleton &other) const {
   return result;
 }
 
-void Skeleton::init() {
-  bones_.push_back(Bone(-0.0881862, -0.223678, -0.929536));
-  bones_.push_back(Bone(-0.566275, -0.541542, -0.899938));
-  bones_.push_back(Bone(-0.616166, -1.19613, -1.0551));
-  bones_.push_back(Bone(-0.614267, -1.74914, -1.16717));
-  bones_.push_back(Bone(-0.86033, -1.84008, -0.670307));
-  bones_.push_back(Bone(-0.0871545, 0.0924213, -0.927642));
-  bones_.push_back(Bone(-0.0640778, 0.577047, -0.846801));
-  bones_.push_back(Bone(-0.113935, 1.09478, -0.921801));
-  bones_.push_back(Bone(0.267937, 0.551273, -0.789762));
-  bones_.push_back(Bone(0.578372, 0.536381, -0.666565));
-  bones_.push_back(Bone(0.824687, 0.573724, -0.517252));
-  bones_.push_back(Bone(1.07611, 0.735785, -0.0939775));
-  bones_.push_back(Bone(1.21808, 0.700675, 0.158607));
-  bones_.push_back(Bone(-0.370623, 0.532531, -0.852921));
-  bones_.push_back(Bone(-0.675322, 0.48007, -0.770522));
-  bones_.push_back(Bone(-0.936812, 0.474334, -0.677436));
-  bones_.push_back(Bone(-1.26404, 0.784372, -0.351252));
-  bones_.push_back(Bone(-1.45527, 0.892911, 0.0528238));
-  bones_.push_back(Bone(0.3686, -0.428869, -0.978191));
-  bones_.push_back(Bone(0.617329, -1.04685, -0.899962));
-  bones_.push_back(Bone(0.593214, -1.71593, -1.08845));
-  bones_.push_back(Bone(0.982818, -1.82164, -0.622992));
-
-  bones_.at(1).SetParent(&bones_.at(0));
-  bones_.at(2).SetParent(&bones_.at(1));
-  bones_.at(3).SetParent(&bones_.at(2));
-  bones_.at(4).SetParent(&bones_.at(3));
-  bones_.at(5).SetParent(&bones_.at(0));
-  bones_.at(6).SetParent(&bones_.at(5));
-  bones_.at(7).SetParent(&bones_.at(6));
-  bones_.at(8).SetParent(&bones_.at(6));
-  bones_.at(9).SetParent(&bones_.at(8));
-  bones_.at(10).SetParent(&bones_.at(9));
-  bones_.at(11).SetParent(&bones_.at(10));
-  bones_.at(12).SetParent(&bones_.at(11));
-  bones_.at(13).SetParent(&bones_.at(6));
-  bones_.at(14).SetParent(&bones_.at(13));
-  bones_.at(15).SetParent(&bones_.at(14));
-  bones_.at(16).SetParent(&bones_.at(15));
-  bones_.at(17).SetParent(&bones_.at(16));
-  bones_.at(18).SetParent(&bones_.at(0));
-  bones_.at(19).SetParent(&bones_.at(18));
-  bones_.at(20).SetParent(&bones_.at(19));
-  bones_.at(21).SetParent(&bones_.at(20));
+void Skeleton::UpdateTransforms() {
+  int num_bones = parent_indices_.size();
+  for (int i = 0; i < num_bones; i++) {
+    int parent = parent_indices_[i];
+
+    // A bone needs recomputed if it has changed itself, or if anything
+    // above it has. Parents are always visited first.
+    bool dirty = !transforms_valid_ ||
+        !(transform_rotations_[i] == rotations_[i]) ||
+        !(transform_positions_[i] == positions_[i]) ||
+        (parent >= 0 && transform_dirty_[parent]);
+    transform_dirty_[i] = dirty;
+    if (!dirty) {
+      continue;
+    }
+
+    changed_bones_[i] = true;
+    any_bone_changed_ = true;
+    transform_rotations_[i] = rotations_[i];
+    transform_positions_[i] = positions_[i];
+
+    if (parent < 0) {
+      // The root bone's transform is always I.
+      CreateIdentityMatrix(&transforms_[i]);
+    } else {
+      Matrix4x4 local_M;
+      CalculateLocalM(rotations_[i], positions_[i], positions_[parent],
+          &local_M);
+      transforms_[i] = ComposeAffine(transforms_[parent], local_M);
+    }
+
+    // The rest transform is a translation to the rest position, so folding
+    // in its inverse only changes the translation: M * T(-r) = [A, t - Ar].
+    const Matrix4x4 &m = transforms_[i];
+    const Vector3d<float> &rest = rest_positions_[i];
+    Matrix3x4 &skinning_matrix = skinning_matrices_[i];
+    for (int row = 0; row < 3; row++) {
+      skinning_matrix(row, 0) = m(row, 0);
+      skinning_matrix(row, 1) = m(row, 1);
+      skinning_matrix(row, 2) = m(row, 2);
+      skinning_matrix(row, 3) = m(row, 3) - (m(row, 0) * rest[0] +
+          m(row, 1) * rest[1] + m(row, 2) * rest[2]);
+    }
+  }
+
+  transforms_valid_ = true;
 }
 
-void Skeleton::Reset() {
-  for (std::vector<Bone>::iterator it = bones_.begin();
-       it != bones_.end(); it++) {
-    (*it).SetRotation(Vector3d<int>(0, 0, 0));
-    (*it).SetPosition((*it).RestPosition());
+void Skeleton::ClearChangedBones() {
+  for (unsigned int i = 0; i < changed_bones_.size(); i++) {
+    changed_bones_[i] = false;
   }
+  any_bone_changed_ = false;
+}
+
+void Skeleton::SetBones(const std::vector<Vector3d<float> > &rest_positions,
+    const std::vector<int> &parent_indices) {
+  int num_bones = parent_indices.size();
+  parent_indices_ = parent_indices;
+  rest_positions_ = rest_positions;
+  positions_ = rest_positions;
+  rotations_.assign(num_bones, Vector3d<int>(0, 0, 0));
+
+  transforms_.resize(num_bones);
+  skinning_matrices_.resize(num_bones);
+  transform_rotations_.resize(num_bones);
+  transform_positions_.resize(num_bones);
+  transform_dirty_.resize(num_bones);
+  transforms_valid_ = false;
+  changed_bones_.assign(num_bones, true);
+  any_bone_changed_ = true;
+}
+
+void Skeleton::Reset() {
+  rotations_.assign(rotations_.size(), Vector3d<int>(0, 0, 0));
+  positions_ = rest_positions_;
 }
 }
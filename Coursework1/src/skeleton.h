@@ -5,48 +5,162 @@
 
 #include <vector>
 
-#include "./bone.h"
+#include "./array_view.h"
+#include "./fixed_matrix-inl.h"
 #include "./vector3d-inl.h"
 
 namespace computer_animation {
 
 //! \class Skeleton
 //! \brief Represents the skeleton that the model is rigged to.
+//!
+//! Each bone is represented by its child joint, and has a rest position, a
+//! current position and a rotation at the joint. The bones are stored as
+//! parallel arrays indexed by bone number, with each bone's parent given
+//! as a bone number, and are numbered so that every parent comes before
+//! its children. A skeleton holds no pointers, so can be copied freely.
 class Skeleton {
   public:
-    Skeleton() {
-      // Intialize the hard-coded bone vector.
-      init();
-    }
+    //! \brief Creates a skeleton with no bones.
+    //!
+    //! Bones come from Load(), or from assigning another skeleton.
+    Skeleton();
 
-    //! \brief Move the i-th bone to a position, using the CCD technique.
+    //! \brief Loads a skeleton from a file, replacing the current one.
+    //!
+    //! Each line of the file describes one bone, and conforms to:
     //!
-    //! Currently does not fully implement CCD. See the comments in the
-    //! implementation for details.
-    void CCDMoveBoneTo(int i, Vector3d<float> position);
+    //! [bone_number] [x] [y] [z] [parent_number]
+    //!
+    //! where (x, y, z) is the bone's rest position and the root bone's
+    //! parent is -1. The lines may be in any order, but every bone from 0
+    //! up must be given exactly once, and every bone must be numbered
+    //! after its parent. Returns false, leaving the skeleton unchanged, if
+    //! the file cannot be read or is not a valid skeleton.
+    bool Load(const char *filename);
 
     //! \brief Adjusts the rotation of the i-th bone.
     //!
     //! The given delta_rotation is added to the bone's current rotation.
     void AdjustBoneRotation(int i, Vector3d<int> delta_rotation);
 
-    //! \brief Sets the skeleton's bones to those of another skeleton.
+    //! \brief Sets the pose of the skeleton to that of another skeleton.
+    //!
+    //! If the other skeleton has the same bones, only the current positions
+    //! and rotations are copied, so the cached transforms are kept and only
+    //! the bones that differ are recomputed. Otherwise the skeleton becomes
+    //! a copy of the other one.
     Skeleton& operator=(const Skeleton &rhs);
 
-    //! \brief Subtracts the skeleton's bones by those of another skeleton.
+    //! \brief Subtracts the current positions and rotations of another
+    //! skeleton's bones from this skeleton's.
     Skeleton& operator-=(const Skeleton &rhs);
 
     //! \brief Subtracts one skeleton from another.
     const Skeleton operator-(const Skeleton &other) const;
 
-    //! \brief Returns the i-th bone of the skeleton.
-    inline Bone& GetBone(int i) { return bones_[i]; }
+    //! \brief Returns the number of bones in the skeleton.
+    inline const int GetNumberBones() const { return parent_indices_.size(); }
 
-    //! \brief Returns the i-th bone of the skeleton.
-    inline Bone GetBone(int i) const { return bones_[i]; }
+    //! \brief Returns the index of the i-th bone's parent, or -1 for the root.
+    inline int ParentIndex(int i) const { return parent_indices_[i]; }
 
-    //! \brief Returns the number of bones in the skeleton.
-    inline const int GetNumberBones() const { return bones_.size(); }
+    //! \brief Returns the rest position of the i-th bone.
+    inline const Vector3d<float>& RestPosition(int i) const {
+      return rest_positions_[i];
+    }
+
+    //! \brief Returns the current position of the i-th bone.
+    inline const Vector3d<float>& CurrentPosition(int i) const {
+      return positions_[i];
+    }
+
+    //! \brief Sets the current position of the i-th bone.
+    inline void SetPosition(int i, const Vector3d<float> &position) {
+      positions_[i] = position;
+    }
+
+    //! \brief Returns the rotation at the child joint of the i-th bone.
+    inline const Vector3d<int>& Rotation(int i) const {
+      return rotations_[i];
+    }
+
+    //! \brief Sets the rotation at the child joint of the i-th bone, in
+    //! degrees around each axis.
+    inline void SetRotation(int i, const Vector3d<int> &rotation) {
+      rotations_[i][0] = rotation[0] % 360;
+      rotations_[i][1] = rotation[1] % 360;
+      rotations_[i][2] = rotation[2] % 360;
+    }
+
+    //! \brief Returns the parent of every bone, indexed by bone number.
+    inline ArrayView<int> parent_indices() const {
+      return ArrayView<int>(parent_indices_.data(), parent_indices_.size());
+    }
+
+    //! \brief Returns the rest position of every bone, indexed by bone
+    //! number.
+    inline ArrayView<Vector3d<float> > rest_positions() const {
+      return ArrayView<Vector3d<float> >(rest_positions_.data(),
+          rest_positions_.size());
+    }
+
+    //! \brief Returns the current position of every bone, indexed by bone
+    //! number.
+    inline ArrayView<Vector3d<float> > positions() const {
+      return ArrayView<Vector3d<float> >(positions_.data(),
+          positions_.size());
+    }
+
+    //! \brief Returns the rotation of every bone, indexed by bone number.
+    inline ArrayView<Vector3d<int> > rotations() const {
+      return ArrayView<Vector3d<int> >(rotations_.data(), rotations_.size());
+    }
+
+    //! \brief Brings the cached world transform of every bone up to date.
+    //!
+    //! The transforms are computed in a single pass over the bones, parents
+    //! before children, with each bone's transform built from its parent's
+    //! cached one. Only bones whose rotation or position changed since the
+    //! last update, and the subtrees below them, are recomputed. The
+    //! skinning matrices are updated along with the transforms.
+    void UpdateTransforms();
+
+    //! \brief Returns the world transform (M matrix) of each bone.
+    //!
+    //! The array is indexed by bone number and is only valid as of the last
+    //! call to UpdateTransforms().
+    inline ArrayView<Matrix4x4> transforms() const {
+      return ArrayView<Matrix4x4>(transforms_.data(), transforms_.size());
+    }
+
+    //! \brief Returns the skinning matrix of each bone.
+    //!
+    //! The skinning matrix is the bone's M matrix multiplied by the inverse
+    //! of its rest transform, so a vertex v influenced by the bone moves to
+    //! the skinning matrix times v. The array is indexed by bone number and
+    //! is only valid as of the last call to UpdateTransforms().
+    inline ArrayView<Matrix3x4> skinning_matrices() const {
+      return ArrayView<Matrix3x4>(skinning_matrices_.data(),
+          skinning_matrices_.size());
+    }
+
+    //! \brief Returns whether the i-th bone's transforms have changed since
+    //! the last call to ClearChangedBones().
+    //!
+    //! Changes are only noticed by UpdateTransforms(), so this reflects the
+    //! pose as of the last update. Initially every bone counts as changed.
+    inline bool BoneChanged(int i) const { return changed_bones_[i]; }
+
+    //! \brief Returns whether any bone has changed since the last call to
+    //! ClearChangedBones().
+    inline bool AnyBoneChanged() const { return any_bone_changed_; }
+
+    //! \brief Marks every bone as unchanged.
+    //!
+    //! Called by whatever consumes the transforms (e.g. the SkinningEngine)
+    //! once it has caught up with the current pose.
+    void ClearChangedBones();
 
     //! \brief Resets the skeleton to it's rest position.
     //!
@@ -55,16 +169,31 @@ class Skeleton {
     void Reset();
 
   private:
-    //! \brief Initializes the links between bones.
-    void init();
-
-    std::vector<Bone> bones_;
-    // The allowable error between a target point and the effector when
-    // doing CCD.
-    static const float kCCDDistanceThreshold = 0;
-
-    // The maximum number of iterations performed when doing CCD.
-    static const int kMaxCCDIterations = 1;
+    // Replaces the bones with ones at the given rest positions, in the rest
+    // pose, and sizes the transform cache to match. Parents must come
+    // before their children.
+    void SetBones(const std::vector<Vector3d<float> > &rest_positions,
+        const std::vector<int> &parent_indices);
+
+    // The bones, indexed by bone number.
+    std::vector<int> parent_indices_;
+    std::vector<Vector3d<float> > rest_positions_;
+    std::vector<Vector3d<float> > positions_;
+    std::vector<Vector3d<int> > rotations_;  // In degrees around each axis.
+
+    // The world transform palette, and the rotation and position each
+    // bone had when its entry was last computed.
+    std::vector<Matrix4x4> transforms_;
+    std::vector<Matrix3x4> skinning_matrices_;
+    std::vector<Vector3d<int> > transform_rotations_;
+    std::vector<Vector3d<float> > transform_positions_;
+    std::vector<char> transform_dirty_;
+    bool transforms_valid_;
+
+    // The bones whose transforms have been recomputed since the last call
+    // to ClearChangedBones().
+    std::vector<char> changed_bones_;
+    bool any_bone_changed_;
 };
 }
 
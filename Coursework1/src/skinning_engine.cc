@@ -0,0 +1,580 @@
+//! \author Stephen McGruer
+
+#include "./skinning_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace computer_animation {
+
+namespace {
+
+// Vertices are skinned in blocks of this size, both when splitting the
+// work between threads and when deciding what needs re-skinned. 16 vertices
+// of output is exactly three cache lines, and 16 vertices of each input
+// array is exactly one.
+const int kBlockSize = 16;
+
+// The number of chunks of work each thread gets, on average. More than one
+// chunk per thread lets faster threads pick up the slack from slower ones.
+const int kChunksPerThread = 4;
+
+// Runs a skinning kernel over ranges of blocks. If a list of blocks is
+// given the ranges index into it, otherwise they are block numbers.
+class SkinTask : public ParallelTask {
+  public:
+    SkinTask(SkinningKernel kernel, const SkinningBuffers &buffers,
+        const int* blocks)
+        : kernel_(kernel), buffers_(buffers), blocks_(blocks) {
+    }
+
+    void Run(int begin, int end) {
+      if (blocks_ == NULL) {
+        RunSkinningKernel(kernel_, buffers_, begin * kBlockSize,
+            end * kBlockSize);
+        return;
+      }
+
+      // Skin runs of consecutive blocks with a single kernel call.
+      int i = begin;
+      while (i < end) {
+        int first = blocks_[i];
+        int last = first;
+        while (++i < end && blocks_[i] == last + 1) {
+          last++;
+        }
+        RunSkinningKernel(kernel_, buffers_, first * kBlockSize,
+            (last + 1) * kBlockSize);
+      }
+    }
+
+  private:
+    SkinningKernel kernel_;
+    const SkinningBuffers &buffers_;
+    const int* blocks_;
+};
+
+// Brings a range of instances' transforms up to date and copies their
+// skinning matrices into the instances' palettes.
+class PaletteTask : public ParallelTask {
+  public:
+    PaletteTask(Skeleton* const* skeletons, int num_bones, float* palettes)
+        : skeletons_(skeletons), num_bones_(num_bones), palettes_(palettes) {
+    }
+
+    void Run(int begin, int end) {
+      int palette_size = 12 * num_bones_;
+      for (int i = begin; i < end; i++) {
+        Skeleton* skeleton = skeletons_[i];
+        skeleton->UpdateTransforms();
+        memcpy(palettes_ + i * palette_size,
+            skeleton->skinning_matrices()[0].data(),
+            palette_size * sizeof(float));
+      }
+    }
+
+  private:
+    Skeleton* const* skeletons_;
+    int num_bones_;
+    float* palettes_;
+};
+
+// Runs a skinning kernel over ranges of blocks of a crowd of instances.
+// Index i is block i % num_blocks of instance i / num_blocks, so a range
+// may cover the end of one instance and the start of the next.
+class InstanceSkinTask : public ParallelTask {
+  public:
+    InstanceSkinTask(SkinningKernel kernel, const SkinningBuffers &buffers,
+        int num_blocks, int palette_size, int instance_stride)
+        : kernel_(kernel), buffers_(buffers), num_blocks_(num_blocks),
+          palette_size_(palette_size), instance_stride_(instance_stride) {
+    }
+
+    void Run(int begin, int end) {
+      int i = begin;
+      while (i < end) {
+        int instance = i / num_blocks_;
+        int instance_end = std::min(end, (instance + 1) * num_blocks_);
+
+        SkinningBuffers buffers = buffers_;
+        buffers.bone_matrices += instance * palette_size_;
+        buffers.positions += static_cast<size_t>(instance) *
+            instance_stride_;
+        RunSkinningKernel(kernel_, buffers,
+            (i - instance * num_blocks_) * kBlockSize,
+            (instance_end - instance * num_blocks_) * kBlockSize);
+        i = instance_end;
+      }
+    }
+
+  private:
+    SkinningKernel kernel_;
+    const SkinningBuffers &buffers_;
+    int num_blocks_;
+    int palette_size_;
+    int instance_stride_;
+};
+
+// The buffers used to compute vertex normals from skinned positions.
+struct NormalBuffers {
+  const float* positions;
+  const int* triangle_vertices;
+  const int* vertex_face_offsets;
+  const int* vertex_faces;
+  const int* block_face_offsets;
+  const int* block_faces;
+  int num_vertices;
+  float* face_normals;
+  float* normals;
+};
+
+// Computes the unit normal of each triangle owned by a block, in the same
+// way as TriangleMesh::LoadFile.
+void ComputeFaceNormals(const NormalBuffers &b, int block) {
+  for (int i = b.block_face_offsets[block];
+       i < b.block_face_offsets[block + 1]; i++) {
+    int face = b.block_faces[i];
+    const float* p0 = b.positions + 3 * b.triangle_vertices[3 * face];
+    const float* p1 = b.positions + 3 * b.triangle_vertices[3 * face + 1];
+    const float* p2 = b.positions + 3 * b.triangle_vertices[3 * face + 2];
+
+    float ax = p2[0] - p0[0];
+    float ay = p2[1] - p0[1];
+    float az = p2[2] - p0[2];
+    float bx = p1[0] - p0[0];
+    float by = p1[1] - p0[1];
+    float bz = p1[2] - p0[2];
+    float nx = ay * bz - az * by;
+    float ny = az * bx - ax * bz;
+    float nz = ax * by - ay * bx;
+    float inverse_length = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz);
+
+    float* out = b.face_normals + 3 * face;
+    out[0] = nx * inverse_length;
+    out[1] = ny * inverse_length;
+    out[2] = nz * inverse_length;
+  }
+}
+
+// Averages the normals of the triangles around each vertex of a block.
+// Vertices without triangles, including the padding, get a normal of
+// (0, 0, 1).
+void ComputeVertexNormals(const NormalBuffers &b, int block) {
+  int first_vertex = block * kBlockSize;
+  for (int v = first_vertex; v < first_vertex + kBlockSize; v++) {
+    float* out = b.normals + 3 * v;
+    int first = (v < b.num_vertices) ? b.vertex_face_offsets[v] : 0;
+    int last = (v < b.num_vertices) ? b.vertex_face_offsets[v + 1] : 0;
+    if (first == last) {
+      out[0] = 0.0f;
+      out[1] = 0.0f;
+      out[2] = 1.0f;
+      continue;
+    }
+
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    for (int i = first; i < last; i++) {
+      const float* face_normal = b.face_normals + 3 * b.vertex_faces[i];
+      x += face_normal[0];
+      y += face_normal[1];
+      z += face_normal[2];
+    }
+
+    float inverse_count = 1.0f / (last - first);
+    out[0] = x * inverse_count;
+    out[1] = y * inverse_count;
+    out[2] = z * inverse_count;
+  }
+}
+
+// Runs one of the normal passes over ranges of blocks, indexing into a list
+// of blocks if one is given, as SkinTask does.
+class NormalTask : public ParallelTask {
+  public:
+    NormalTask(void (*pass)(const NormalBuffers&, int),
+        const NormalBuffers &buffers, const int* blocks)
+        : pass_(pass), buffers_(buffers), blocks_(blocks) {
+    }
+
+    void Run(int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        pass_(buffers_, (blocks_ == NULL) ? i : blocks_[i]);
+      }
+    }
+
+  private:
+    void (*pass_)(const NormalBuffers&, int);
+    const NormalBuffers &buffers_;
+    const int* blocks_;
+};
+}  // namespace
+
+SkinningEngine::SkinningEngine()
+    : num_vertices_(0), padded_vertices_(0), num_slots_(0),
+      kernel_(BestSupportedKernel()), positions_valid_(false),
+      last_skinned_vertices_(0), normals_enabled_(false),
+      normals_valid_(false), num_bones_(0), num_instances_(0),
+      pool_(new ThreadPool(ThreadPool::HardwareThreads())) {
+}
+
+SkinningEngine::~SkinningEngine() {
+  delete pool_;
+}
+
+void SkinningEngine::Init(const TriangleMesh &mesh) {
+  num_vertices_ = mesh.GetNumberOfVertices();
+  padded_vertices_ = (num_vertices_ + kBlockSize - 1) / kBlockSize *
+      kBlockSize;
+  int num_blocks = padded_vertices_ / kBlockSize;
+
+  // The bones are used to index the skinning matrices and the reverse
+  // index below, so a bone the skeleton lacks cannot be skipped safely.
+  int num_bones = mesh.skeleton()->GetNumberBones();
+  num_slots_ = 0;
+  for (int i = 0; i < num_vertices_; i++) {
+    const BoneInfluence* influences = mesh.GetInfluences(i);
+    int num_influences = mesh.GetNumberOfInfluences(i);
+    for (int s = 0; s < num_influences; s++) {
+      if (influences[s].bone < 0 || influences[s].bone >= num_bones) {
+        fprintf(stderr, "Error: Vertex %d uses bone %d, but the mesh's "
+            "skeleton has %d bones (was its skeleton loaded?)\n", i,
+            influences[s].bone, num_bones);
+        exit(1);
+      }
+    }
+    if (num_influences > num_slots_) {
+      num_slots_ = num_influences;
+    }
+  }
+
+  // Resizing zeroes the buffers, so the padding vertices and unused
+  // influence slots are all bone 0 with a weight of 0.
+  rest_x_.Resize(padded_vertices_);
+  rest_y_.Resize(padded_vertices_);
+  rest_z_.Resize(padded_vertices_);
+  bones_.Resize(num_slots_ * padded_vertices_);
+  weights_.Resize(num_slots_ * padded_vertices_);
+  positions_.Resize(3 * padded_vertices_);
+
+  for (int i = 0; i < num_vertices_; i++) {
+    const Vector3d<float> &vertex = mesh.GetVertex(i);
+    rest_x_[i] = vertex[0];
+    rest_y_[i] = vertex[1];
+    rest_z_[i] = vertex[2];
+
+    const BoneInfluence* influences = mesh.GetInfluences(i);
+    int num_influences = mesh.GetNumberOfInfluences(i);
+    for (int s = 0; s < num_influences; s++) {
+      bones_[s * padded_vertices_ + i] = influences[s].bone;
+      weights_[s * padded_vertices_ + i] = influences[s].weight;
+    }
+  }
+
+  // Build the reverse index from each bone to the blocks of vertices that
+  // it influences. Vertices are visited in order, so each bone's blocks
+  // come out sorted and only need checked against the last one added.
+  num_bones_ = num_bones;
+  num_instances_ = 0;
+  std::vector<std::vector<int> > blocks_per_bone(num_bones);
+  for (int i = 0; i < num_vertices_; i++) {
+    const BoneInfluence* influences = mesh.GetInfluences(i);
+    int num_influences = mesh.GetNumberOfInfluences(i);
+    for (int s = 0; s < num_influences; s++) {
+      std::vector<int> &blocks = blocks_per_bone[influences[s].bone];
+      if (blocks.empty() || blocks.back() != i / kBlockSize) {
+        blocks.push_back(i / kBlockSize);
+      }
+    }
+  }
+
+  bone_block_offsets_.assign(1, 0);
+  bone_blocks_.clear();
+  for (int b = 0; b < num_bones; b++) {
+    bone_blocks_.insert(bone_blocks_.end(), blocks_per_bone[b].begin(),
+        blocks_per_bone[b].end());
+    bone_block_offsets_.push_back(bone_blocks_.size());
+  }
+
+  block_dirty_.assign(num_blocks, false);
+  dirty_blocks_.clear();
+  dirty_blocks_.reserve(num_blocks);
+  positions_valid_ = false;
+
+  // Copy the mesh's connectivity for the normal passes.
+  int num_triangles = mesh.GetNumberOfTriangles();
+  triangle_vertices_.resize(3 * num_triangles);
+  for (int t = 0; t < num_triangles; t++) {
+    mesh.GetTriangle(t).GetVertexIndices(&triangle_vertices_[3 * t],
+        &triangle_vertices_[3 * t + 1], &triangle_vertices_[3 * t + 2]);
+  }
+  vertex_face_offsets_.assign(1, 0);
+  vertex_faces_.clear();
+  for (int i = 0; i < num_vertices_; i++) {
+    const int* faces = mesh.GetVertexFaces(i);
+    vertex_faces_.insert(vertex_faces_.end(), faces,
+        faces + mesh.GetNumberOfVertexFaces(i));
+    vertex_face_offsets_.push_back(vertex_faces_.size());
+  }
+
+  // Each triangle is owned by the block holding its lowest vertex, which
+  // is found by visiting each triangle from that vertex. The neighbours of
+  // a block are found from the triangles around its vertices, using the
+  // last block that marked each neighbour to skip duplicates.
+  block_face_offsets_.assign(1, 0);
+  block_faces_.clear();
+  block_neighbour_offsets_.assign(1, 0);
+  block_neighbours_.clear();
+  std::vector<int> marked_by(num_blocks, -1);
+  for (int block = 0; block < num_blocks; block++) {
+    int end_vertex = std::min((block + 1) * kBlockSize, num_vertices_);
+    for (int v = block * kBlockSize; v < end_vertex; v++) {
+      for (int i = vertex_face_offsets_[v]; i < vertex_face_offsets_[v + 1];
+           i++) {
+        int face = vertex_faces_[i];
+        const int* corners = &triangle_vertices_[3 * face];
+        if (v == std::min(corners[0], std::min(corners[1], corners[2]))) {
+          block_faces_.push_back(face);
+        }
+        for (int c = 0; c < 3; c++) {
+          int neighbour = corners[c] / kBlockSize;
+          if (marked_by[neighbour] != block) {
+            marked_by[neighbour] = block;
+            block_neighbours_.push_back(neighbour);
+          }
+        }
+      }
+    }
+    block_face_offsets_.push_back(block_faces_.size());
+    block_neighbour_offsets_.push_back(block_neighbours_.size());
+  }
+
+  face_normals_.Resize(3 * num_triangles);
+  normals_.Resize(3 * padded_vertices_);
+  normal_block_dirty_.assign(num_blocks, false);
+  normal_blocks_.clear();
+  normal_blocks_.reserve(num_blocks);
+  normals_valid_ = false;
+}
+
+void SkinningEngine::Skin(Skeleton *skeleton) {
+  skeleton->UpdateTransforms();
+
+  // If the pose has not changed, the previous output is still correct.
+  last_skinned_vertices_ = 0;
+  if (positions_valid_ && !skeleton->AnyBoneChanged()) {
+    if (normals_enabled_ && !normals_valid_) {
+      UpdateNormals(NULL, 0);
+    }
+    return;
+  }
+
+  SkinningBuffers buffers;
+  buffers.rest_x = rest_x_.data();
+  buffers.rest_y = rest_y_.data();
+  buffers.rest_z = rest_z_.data();
+  buffers.bones = bones_.data();
+  buffers.weights = weights_.data();
+  buffers.num_slots = num_slots_;
+  buffers.stride = padded_vertices_;
+  buffers.bone_matrices = skeleton->skinning_matrices()[0].data();
+  buffers.positions = positions_.data();
+
+  int num_blocks = padded_vertices_ / kBlockSize;
+  const int* blocks = NULL;
+  if (positions_valid_) {
+    // Only re-skin the blocks influenced by the bones that changed.
+    int num_bones = skeleton->GetNumberBones();
+    for (int b = 0; b < num_bones; b++) {
+      if (!skeleton->BoneChanged(b)) {
+        continue;
+      }
+      for (int i = bone_block_offsets_[b]; i < bone_block_offsets_[b + 1];
+           i++) {
+        block_dirty_[bone_blocks_[i]] = true;
+      }
+    }
+
+    dirty_blocks_.clear();
+    for (int i = 0; i < num_blocks; i++) {
+      if (block_dirty_[i]) {
+        dirty_blocks_.push_back(i);
+        block_dirty_[i] = false;
+      }
+    }
+    blocks = dirty_blocks_.data();
+    num_blocks = dirty_blocks_.size();
+  }
+
+  int chunk_size = num_blocks / (kChunksPerThread * num_threads()) + 1;
+
+  SkinTask task(kernel_, buffers, blocks);
+  pool_->ParallelFor(&task, 0, num_blocks, chunk_size);
+
+  if (normals_enabled_) {
+    UpdateNormals(blocks, num_blocks);
+  }
+
+  skeleton->ClearChangedBones();
+  positions_valid_ = true;
+  last_skinned_vertices_ = num_blocks * kBlockSize;
+}
+
+void SkinningEngine::SkinInstances(Skeleton* const* skeletons,
+    int num_instances) {
+  // Only reallocate when the crowd changes size, as resizing clears the
+  // buffers.
+  int palette_size = 12 * num_bones_;
+  if (palettes_.size() != num_instances * palette_size ||
+      instance_positions_.size() != num_instances * instance_stride()) {
+    palettes_.Resize(num_instances * palette_size);
+    instance_positions_.Resize(num_instances * instance_stride());
+  }
+  num_instances_ = num_instances;
+
+  PaletteTask palette_task(skeletons, num_bones_, palettes_.data());
+  pool_->ParallelFor(&palette_task, 0, num_instances,
+      num_instances / (kChunksPerThread * num_threads()) + 1);
+
+  SkinningBuffers buffers;
+  buffers.rest_x = rest_x_.data();
+  buffers.rest_y = rest_y_.data();
+  buffers.rest_z = rest_z_.data();
+  buffers.bones = bones_.data();
+  buffers.weights = weights_.data();
+  buffers.num_slots = num_slots_;
+  buffers.stride = padded_vertices_;
+  buffers.bone_matrices = palettes_.data();
+  buffers.positions = instance_positions_.data();
+
+  int num_blocks = padded_vertices_ / kBlockSize;
+  int total_blocks = num_instances * num_blocks;
+  int chunk_size = total_blocks / (kChunksPerThread * num_threads()) + 1;
+  InstanceSkinTask task(kernel_, buffers, num_blocks, palette_size,
+      instance_stride());
+  pool_->ParallelFor(&task, 0, total_blocks, chunk_size);
+}
+
+void SkinningEngine::SetNormalsEnabled(bool enabled) {
+  normals_enabled_ = enabled;
+  normals_valid_ = false;
+}
+
+void SkinningEngine::UpdateNormals(const int* blocks, int num_blocks) {
+  if (!normals_valid_) {
+    blocks = NULL;
+  }
+
+  int num_normal_blocks = padded_vertices_ / kBlockSize;
+  const int* normal_blocks = NULL;
+  if (blocks != NULL) {
+    // Only the blocks that share a triangle with a re-skinned block can
+    // have changed normals, and only the triangles they own can have moved.
+    for (int i = 0; i < num_blocks; i++) {
+      int block = blocks[i];
+      for (int j = block_neighbour_offsets_[block];
+           j < block_neighbour_offsets_[block + 1]; j++) {
+        normal_block_dirty_[block_neighbours_[j]] = true;
+      }
+    }
+
+    normal_blocks_.clear();
+    for (int i = 0; i < num_normal_blocks; i++) {
+      if (normal_block_dirty_[i]) {
+        normal_blocks_.push_back(i);
+        normal_block_dirty_[i] = false;
+      }
+    }
+    normal_blocks = normal_blocks_.data();
+    num_normal_blocks = normal_blocks_.size();
+  }
+
+  NormalBuffers buffers;
+  buffers.positions = positions_.data();
+  buffers.triangle_vertices = triangle_vertices_.data();
+  buffers.vertex_face_offsets = vertex_face_offsets_.data();
+  buffers.vertex_faces = vertex_faces_.data();
+  buffers.block_face_offsets = block_face_offsets_.data();
+  buffers.block_faces = block_faces_.data();
+  buffers.num_vertices = num_vertices_;
+  buffers.face_normals = face_normals_.data();
+  buffers.normals = normals_.data();
+
+  // Every triangle normal must be finished before any vertex normal is
+  // summed, so the two passes are run one after the other.
+  int chunk_size = num_normal_blocks / (kChunksPerThread * num_threads()) + 1;
+  NormalTask face_task(ComputeFaceNormals, buffers, normal_blocks);
+  pool_->ParallelFor(&face_task, 0, num_normal_blocks, chunk_size);
+  NormalTask vertex_task(ComputeVertexNormals, buffers, normal_blocks);
+  pool_->ParallelFor(&vertex_task, 0, num_normal_blocks, chunk_size);
+
+  normals_valid_ = true;
+}
+
+bool SkinningEngine::SetKernel(SkinningKernel kernel) {
+  if (!KernelSupported(kernel)) {
+    return false;
+  }
+  kernel_ = kernel;
+  positions_valid_ = false;
+  normals_valid_ = false;
+  return true;
+}
+
+void SkinningEngine::SetNumThreads(int num_threads) {
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  if (num_threads == pool_->num_threads()) {
+    return;
+  }
+
+  delete pool_;
+  pool_ = new ThreadPool(num_threads);
+}
+
+void SkinReference(TriangleMesh *mesh,
+    std::vector<Vector3d<float> > *positions) {
+  Skeleton* skeleton = mesh->skeleton();
+  skeleton->UpdateTransforms();
+  ArrayView<Matrix4x4> ms = skeleton->transforms();
+
+  ArrayView<Vector3d<float> > rest_positions = skeleton->rest_positions();
+  ArrayView<Vector3d<float> > vertices = mesh->vertices();
+
+  int number_of_vertices = vertices.size();
+  positions->resize(number_of_vertices);
+
+  for (int i = 0; i < number_of_vertices; i++) {
+    const Vector3d<float> &v_hat = vertices[i];
+    Vector3d<float> v(0, 0, 0);
+
+    ArrayView<BoneInfluence> influences = mesh->influences(i);
+    for (unsigned int j = 0; j < influences.size(); j++) {
+      int b = influences[j].bone;
+      float weight = influences[j].weight;
+
+      // M_hat^-1
+      Vector3d<float> tmp = v_hat - rest_positions[b];
+
+      // M
+      Vector4 result = ms[b] * Vector4(tmp, 1.0f);
+
+      tmp[0] = (result[0] / result[3]);
+      tmp[1] = (result[1] / result[3]);
+      tmp[2] = (result[2] / result[3]);
+
+      // W_i
+      tmp *= weight;
+
+      v += tmp;
+    }
+
+    (*positions)[i] = v;
+  }
+}
+}
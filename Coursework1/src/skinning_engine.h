@@ -0,0 +1,252 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_SKINNING_ENGINE_H_
+#define SRC_SKINNING_ENGINE_H_
+
+#include <vector>
+
+#include "./aligned_array.h"
+#include "./skeleton.h"
+#include "./skinning_kernels.h"
+#include "./thread_pool.h"
+#include "./triangle_mesh.h"
+#include "./vector3d-inl.h"
+
+namespace computer_animation {
+
+//! \class SkinningEngine
+//! \brief Deforms a TriangleMesh to follow its skeleton, using linear
+//! blending.
+//!
+//! The mesh's rest positions and bone influences are copied into
+//! structure-of-arrays buffers when the engine is initialized, so that the
+//! SIMD kernels can skin several vertices per instruction. The widest
+//! kernel that the CPU supports is picked at runtime.
+//!
+//! The vertices are split between the threads of a ThreadPool that lives
+//! as long as the engine. Each thread writes whole cache lines of the
+//! output, so threads never share a line.
+//!
+//! The engine keeps its output between calls to Skin(). Using the
+//! skeleton's record of which bones have changed, and an index from each
+//! bone to the vertices it influences, only the vertices that could have
+//! moved are re-skinned. An engine should therefore only be used with one
+//! skeleton.
+//!
+//! The engine can also recompute the vertex normals of the skinned mesh,
+//! in the same way that TriangleMesh::LoadFile computes the rest normals.
+//! Each block of vertices owns the triangles whose lowest vertex it holds.
+//! The triangle normals are computed for the blocks that share a triangle
+//! with a re-skinned block, then the vertex normals of those blocks are
+//! summed from the triangles around each vertex. Every output is written
+//! by exactly one thread, so no atomics are needed.
+//!
+//! An engine can also skin a crowd of instances of the mesh, each posed by
+//! a skeleton of its own, with SkinInstances().
+class SkinningEngine {
+  public:
+    SkinningEngine();
+
+    ~SkinningEngine();
+
+    //! \brief Prepares the engine to skin a mesh.
+    //!
+    //! Must be called again if the mesh or its weights change. The mesh's
+    //! skeleton must already be loaded (see TriangleMesh::LoadSkeleton()):
+    //! exits if any weight uses a bone that the skeleton does not have.
+    void Init(const TriangleMesh &mesh);
+
+    //! \brief Skins the mesh to the current pose of a skeleton.
+    //!
+    //! The skeleton's transforms are brought up to date first. Each vertex
+    //! is then the weighted sum of its bones' skinning matrices applied to
+    //! it. Only vertices influenced by bones that have changed since the
+    //! last call are re-skinned, and the skeleton's changed bones are
+    //! cleared afterwards.
+    void Skin(Skeleton *skeleton);
+
+    //! \brief Skins one instance of the mesh for each of a crowd of
+    //! skeletons.
+    //!
+    //! Each skeleton's transforms are brought up to date and its skinning
+    //! matrices copied into a palette for its instance. Every vertex of
+    //! every instance is then skinned in a single parallel job, split
+    //! between the threads by blocks of vertices across all the instances,
+    //! and sharing the engine's one copy of the rest positions and weights.
+    //!
+    //! The skeletons' changed bones are neither used nor cleared, and
+    //! normals are not computed. The output of Skin() is left alone.
+    void SkinInstances(Skeleton* const* skeletons, int num_instances);
+
+    //! \brief Returns the number of instances skinned by the last call to
+    //! SkinInstances().
+    inline int num_instances() const { return num_instances_; }
+
+    //! \brief Returns the skinned vertex positions of the i-th instance, as
+    //! (x, y, z) triples.
+    //!
+    //! Instances are instance_stride() floats apart.
+    inline const float* instance_positions(int i) const {
+      return instance_positions_.data() + i * instance_stride();
+    }
+
+    //! \brief Returns the number of floats between the positions of one
+    //! instance and the next.
+    inline int instance_stride() const { return 3 * padded_vertices_; }
+
+    //! \brief Returns the number of vertices re-skinned by the last call to
+    //! Skin().
+    //!
+    //! This counts whole blocks of vertices, including padding, so may be
+    //! slightly more than the number of vertices that actually moved.
+    inline int last_skinned_vertices() const {
+      return last_skinned_vertices_;
+    }
+
+    //! \brief Returns the skinned vertex positions, as (x, y, z) triples.
+    inline const float* positions() const { return positions_.data(); }
+
+    //! \brief Returns whether Skin() also recomputes the vertex normals.
+    inline bool normals_enabled() const { return normals_enabled_; }
+
+    //! \brief Sets whether Skin() also recomputes the vertex normals.
+    //!
+    //! Off by default.
+    void SetNormalsEnabled(bool enabled);
+
+    //! \brief Returns the skinned vertex normals, as (x, y, z) triples.
+    //!
+    //! Only valid if normals are enabled.
+    inline const float* normals() const { return normals_.data(); }
+
+    //! \brief Returns the normal of the i-th skinned vertex.
+    //!
+    //! Only valid if normals are enabled.
+    inline Vector3d<float> GetNormal(int i) const {
+      return Vector3d<float>(normals_[3 * i], normals_[3 * i + 1],
+          normals_[3 * i + 2]);
+    }
+
+    //! \brief Returns the i-th skinned vertex.
+    inline Vector3d<float> GetPosition(int i) const {
+      return Vector3d<float>(positions_[3 * i], positions_[3 * i + 1],
+          positions_[3 * i + 2]);
+    }
+
+    //! \brief Returns the skinned vertex positions, indexed by vertex.
+    //!
+    //! The view refers to the same storage as positions(), so is
+    //! overwritten by the next call to Skin().
+    inline ArrayView<Vector3d<float> > skinned_positions() const {
+      return ArrayView<Vector3d<float> >(
+          reinterpret_cast<const Vector3d<float>*>(positions_.data()),
+          num_vertices_);
+    }
+
+    //! \brief Returns the skinned vertex normals, indexed by vertex.
+    //!
+    //! Only valid if normals are enabled.
+    inline ArrayView<Vector3d<float> > skinned_normals() const {
+      return ArrayView<Vector3d<float> >(
+          reinterpret_cast<const Vector3d<float>*>(normals_.data()),
+          num_vertices_);
+    }
+
+    //! \brief Returns the number of vertices being skinned.
+    inline int num_vertices() const { return num_vertices_; }
+
+    //! \brief Returns the kernel in use.
+    inline SkinningKernel kernel() const { return kernel_; }
+
+    //! \brief Sets the kernel to use.
+    //!
+    //! Returns false, leaving the kernel unchanged, if the CPU cannot run
+    //! the kernel.
+    bool SetKernel(SkinningKernel kernel);
+
+    //! \brief Returns the number of threads used to skin.
+    inline int num_threads() const { return pool_->num_threads(); }
+
+    //! \brief Sets the number of threads used to skin.
+    //!
+    //! By default, one thread per hardware thread is used. Changing the
+    //! number of threads restarts the engine's thread pool, so should not
+    //! be done every frame.
+    void SetNumThreads(int num_threads);
+
+  private:
+    // Copying is not allowed.
+    SkinningEngine(const SkinningEngine&);
+    SkinningEngine& operator=(const SkinningEngine&);
+
+    // Recomputes the normals of the blocks around the given re-skinned
+    // blocks, or of every block if blocks is NULL.
+    void UpdateNormals(const int* blocks, int num_blocks);
+
+    int num_vertices_;
+    int padded_vertices_;
+    int num_slots_;
+    SkinningKernel kernel_;
+
+    AlignedArray<float> rest_x_;
+    AlignedArray<float> rest_y_;
+    AlignedArray<float> rest_z_;
+    AlignedArray<int> bones_;
+    AlignedArray<float> weights_;
+    AlignedArray<float> positions_;
+
+    // Whether positions_ holds the skinned mesh for the last pose.
+    bool positions_valid_;
+    int last_skinned_vertices_;
+
+    // The blocks of vertices influenced by each bone. The blocks for bone b
+    // are those in [bone_block_offsets_[b], bone_block_offsets_[b + 1]).
+    std::vector<int> bone_block_offsets_;
+    std::vector<int> bone_blocks_;
+
+    // Scratch space used to find the blocks that need re-skinned.
+    std::vector<char> block_dirty_;
+    std::vector<int> dirty_blocks_;
+
+    // The mesh's triangles and the triangles around each vertex, as
+    // TriangleMesh::GetVertexFaces() gives them.
+    std::vector<int> triangle_vertices_;
+    std::vector<int> vertex_face_offsets_;
+    std::vector<int> vertex_faces_;
+
+    // The triangles owned by each block, and the blocks that share a
+    // triangle with each block (including itself), stored the same way as
+    // bone_blocks_.
+    std::vector<int> block_face_offsets_;
+    std::vector<int> block_faces_;
+    std::vector<int> block_neighbour_offsets_;
+    std::vector<int> block_neighbours_;
+
+    bool normals_enabled_;
+    bool normals_valid_;
+    AlignedArray<float> face_normals_;
+    AlignedArray<float> normals_;
+
+    // Scratch space used to find the blocks that need new normals.
+    std::vector<char> normal_block_dirty_;
+    std::vector<int> normal_blocks_;
+
+    // The skinning matrices of each instance, num_bones_ 3x4 matrices per
+    // instance, and the skinned positions of each instance.
+    int num_bones_;
+    int num_instances_;
+    AlignedArray<float> palettes_;
+    AlignedArray<float> instance_positions_;
+
+    ThreadPool* pool_;
+};
+
+//! \brief Skins a mesh one vertex and one bone at a time.
+//!
+//! This is the straightforward version of the skinning that
+//! SkinningEngine performs, used to check the engine's kernels.
+void SkinReference(TriangleMesh *mesh,
+    std::vector<Vector3d<float> > *positions);
+}
+
+#endif  // SRC_SKINNING_ENGINE_H_
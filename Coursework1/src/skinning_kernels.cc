@@ -0,0 +1,195 @@
+//! \author Stephen McGruer
+
+#include "./skinning_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAV_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace computer_animation {
+
+namespace {
+
+// Skins vertices one at a time. Each vertex is the weighted sum of its
+// bones' skinning matrices applied to it. The arithmetic is done in the
+// same order as the SIMD kernels so that all kernels give the same results.
+void SkinScalar(const SkinningBuffers &b, int begin, int end) {
+  for (int v = begin; v < end; v++) {
+    float x = b.rest_x[v];
+    float y = b.rest_y[v];
+    float z = b.rest_z[v];
+    float out_x = 0.0f;
+    float out_y = 0.0f;
+    float out_z = 0.0f;
+
+    for (int s = 0; s < b.num_slots; s++) {
+      int bone = b.bones[s * b.stride + v];
+      float weight = b.weights[s * b.stride + v];
+      const float* m = b.bone_matrices + bone * 12;
+
+      out_x += (m[0] * x + m[1] * y + m[2] * z + m[3]) * weight;
+      out_y += (m[4] * x + m[5] * y + m[6] * z + m[7]) * weight;
+      out_z += (m[8] * x + m[9] * y + m[10] * z + m[11]) * weight;
+    }
+
+    b.positions[3 * v] = out_x;
+    b.positions[3 * v + 1] = out_y;
+    b.positions[3 * v + 2] = out_z;
+  }
+}
+
+#ifdef CAV_X86_KERNELS
+// Skins four vertices at a time. SSE has no gather instruction, so the
+// per-lane bone data is loaded with scalar loads.
+void SkinSse(const SkinningBuffers &b, int begin, int end) {
+  for (int v = begin; v < end; v += 4) {
+    __m128 x = _mm_load_ps(b.rest_x + v);
+    __m128 y = _mm_load_ps(b.rest_y + v);
+    __m128 z = _mm_load_ps(b.rest_z + v);
+    __m128 out_x = _mm_setzero_ps();
+    __m128 out_y = _mm_setzero_ps();
+    __m128 out_z = _mm_setzero_ps();
+
+    for (int s = 0; s < b.num_slots; s++) {
+      const int* bones = b.bones + s * b.stride + v;
+      __m128 weight = _mm_load_ps(b.weights + s * b.stride + v);
+
+      const float* m0 = b.bone_matrices + bones[0] * 12;
+      const float* m1 = b.bone_matrices + bones[1] * 12;
+      const float* m2 = b.bone_matrices + bones[2] * 12;
+      const float* m3 = b.bone_matrices + bones[3] * 12;
+
+      __m128 rows[3];
+      for (int row = 0; row < 3; row++) {
+        int k = row * 4;
+        __m128 r = _mm_mul_ps(
+            _mm_setr_ps(m0[k], m1[k], m2[k], m3[k]), x);
+        r = _mm_add_ps(r, _mm_mul_ps(
+            _mm_setr_ps(m0[k + 1], m1[k + 1], m2[k + 1], m3[k + 1]), y));
+        r = _mm_add_ps(r, _mm_mul_ps(
+            _mm_setr_ps(m0[k + 2], m1[k + 2], m2[k + 2], m3[k + 2]), z));
+        rows[row] = _mm_add_ps(r,
+            _mm_setr_ps(m0[k + 3], m1[k + 3], m2[k + 3], m3[k + 3]));
+      }
+
+      out_x = _mm_add_ps(out_x, _mm_mul_ps(rows[0], weight));
+      out_y = _mm_add_ps(out_y, _mm_mul_ps(rows[1], weight));
+      out_z = _mm_add_ps(out_z, _mm_mul_ps(rows[2], weight));
+    }
+
+    float lanes[3][4] __attribute__((aligned(16)));
+    _mm_store_ps(lanes[0], out_x);
+    _mm_store_ps(lanes[1], out_y);
+    _mm_store_ps(lanes[2], out_z);
+    float* positions = b.positions + 3 * v;
+    for (int lane = 0; lane < 4; lane++) {
+      positions[3 * lane] = lanes[0][lane];
+      positions[3 * lane + 1] = lanes[1][lane];
+      positions[3 * lane + 2] = lanes[2][lane];
+    }
+  }
+}
+
+// Skins eight vertices at a time, gathering the per-lane bone data.
+__attribute__((target("avx2")))
+void SkinAvx2(const SkinningBuffers &b, int begin, int end) {
+  for (int v = begin; v < end; v += 8) {
+    __m256 x = _mm256_load_ps(b.rest_x + v);
+    __m256 y = _mm256_load_ps(b.rest_y + v);
+    __m256 z = _mm256_load_ps(b.rest_z + v);
+    __m256 out_x = _mm256_setzero_ps();
+    __m256 out_y = _mm256_setzero_ps();
+    __m256 out_z = _mm256_setzero_ps();
+
+    for (int s = 0; s < b.num_slots; s++) {
+      __m256i bones = _mm256_load_si256(
+          reinterpret_cast<const __m256i*>(b.bones + s * b.stride + v));
+      __m256 weight = _mm256_load_ps(b.weights + s * b.stride + v);
+      // Each bone's matrix is 12 floats, so its index is bone * 12.
+      __m256i m = _mm256_add_epi32(_mm256_slli_epi32(bones, 3),
+          _mm256_slli_epi32(bones, 2));
+
+      __m256 rows[3];
+      for (int row = 0; row < 3; row++) {
+        const float* base = b.bone_matrices + row * 4;
+        __m256 r = _mm256_mul_ps(_mm256_i32gather_ps(base, m, 4), x);
+        r = _mm256_add_ps(r,
+            _mm256_mul_ps(_mm256_i32gather_ps(base + 1, m, 4), y));
+        r = _mm256_add_ps(r,
+            _mm256_mul_ps(_mm256_i32gather_ps(base + 2, m, 4), z));
+        rows[row] = _mm256_add_ps(r, _mm256_i32gather_ps(base + 3, m, 4));
+      }
+
+      out_x = _mm256_add_ps(out_x, _mm256_mul_ps(rows[0], weight));
+      out_y = _mm256_add_ps(out_y, _mm256_mul_ps(rows[1], weight));
+      out_z = _mm256_add_ps(out_z, _mm256_mul_ps(rows[2], weight));
+    }
+
+    float lanes[3][8] __attribute__((aligned(32)));
+    _mm256_store_ps(lanes[0], out_x);
+    _mm256_store_ps(lanes[1], out_y);
+    _mm256_store_ps(lanes[2], out_z);
+    float* positions = b.positions + 3 * v;
+    for (int lane = 0; lane < 8; lane++) {
+      positions[3 * lane] = lanes[0][lane];
+      positions[3 * lane + 1] = lanes[1][lane];
+      positions[3 * lane + 2] = lanes[2][lane];
+    }
+  }
+}
+#endif  // CAV_X86_KERNELS
+}  // namespace
+
+bool KernelSupported(SkinningKernel kernel) {
+  switch (kernel) {
+    case kScalarKernel:
+      return true;
+#ifdef CAV_X86_KERNELS
+    case kSseKernel:
+      return __builtin_cpu_supports("sse2");
+    case kAvx2Kernel:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+SkinningKernel BestSupportedKernel() {
+  if (KernelSupported(kAvx2Kernel)) {
+    return kAvx2Kernel;
+  } else if (KernelSupported(kSseKernel)) {
+    return kSseKernel;
+  }
+  return kScalarKernel;
+}
+
+const char* KernelName(SkinningKernel kernel) {
+  switch (kernel) {
+    case kSseKernel:
+      return "sse";
+    case kAvx2Kernel:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+void RunSkinningKernel(SkinningKernel kernel, const SkinningBuffers &buffers,
+    int begin, int end) {
+  switch (kernel) {
+#ifdef CAV_X86_KERNELS
+    case kSseKernel:
+      SkinSse(buffers, begin, end);
+      break;
+    case kAvx2Kernel:
+      SkinAvx2(buffers, begin, end);
+      break;
+#endif
+    default:
+      SkinScalar(buffers, begin, end);
+      break;
+  }
+}
+}
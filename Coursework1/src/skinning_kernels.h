@@ -0,0 +1,64 @@
+//! \author Stephen McGruer
+
+// The inner loops used by SkinningEngine. Each kernel skins the vertices
+// in [begin, end), which must be multiples of kSkinningBlockSize (except
+// that end may also be the padded vertex count).
+
+#ifndef SRC_SKINNING_KERNELS_H_
+#define SRC_SKINNING_KERNELS_H_
+
+namespace computer_animation {
+
+//! \brief The number of vertices that the kernels process at once.
+//!
+//! Vertex buffers are padded to a multiple of this.
+const int kSkinningBlockSize = 8;
+
+//! \brief The available skinning kernels, narrowest first.
+enum SkinningKernel {
+  kScalarKernel,
+  kSseKernel,
+  kAvx2Kernel
+};
+
+//! \struct SkinningBuffers
+//! \brief The buffers read and written by the skinning kernels.
+//!
+//! Per-vertex arrays are structure-of-arrays, padded to a multiple of
+//! kSkinningBlockSize vertices. Influence slot s of vertex v is at
+//! s * stride + v; unused slots have a weight of zero.
+struct SkinningBuffers {
+  // The rest positions of the vertices.
+  const float* rest_x;
+  const float* rest_y;
+  const float* rest_z;
+
+  // The influencing bone and weight for each influence slot.
+  const int* bones;
+  const float* weights;
+  int num_slots;
+  int stride;
+
+  // The skinning matrix of each bone, 12 floats (a 3x4 matrix) per bone
+  // in row-major order.
+  const float* bone_matrices;
+
+  // The skinned positions, 3 floats (x, y, z) per vertex.
+  float* positions;
+};
+
+//! \brief Returns whether the CPU can run a kernel.
+bool KernelSupported(SkinningKernel kernel);
+
+//! \brief Returns the widest kernel that the CPU can run.
+SkinningKernel BestSupportedKernel();
+
+//! \brief Returns a printable name for a kernel.
+const char* KernelName(SkinningKernel kernel);
+
+//! \brief Skins the vertices in [begin, end) with the given kernel.
+void RunSkinningKernel(SkinningKernel kernel, const SkinningBuffers &buffers,
+    int begin, int end);
+}
+
+#endif  // SRC_SKINNING_KERNELS_H_
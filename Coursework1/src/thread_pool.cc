@@ -0,0 +1,104 @@
+//! \author Stephen McGruer
+
+#include "./thread_pool.h"
+
+namespace computer_animation {
+
+ThreadPool::ThreadPool(int num_threads)
+    : task_(NULL), begin_(0), end_(0), chunk_size_(1), num_chunks_(0),
+      next_chunk_(0), generation_(0), busy_workers_(0),
+      shutting_down_(false) {
+  for (int i = 1; i < num_threads; i++) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  work_ready_.notify_all();
+
+  for (unsigned int i = 0; i < workers_.size(); i++) {
+    workers_[i].join();
+  }
+}
+
+void ThreadPool::ParallelFor(ParallelTask *task, int begin, int end,
+    int chunk_size) {
+  if (end <= begin) {
+    return;
+  }
+
+  int num_chunks = (end - begin + chunk_size - 1) / chunk_size;
+  if (workers_.empty() || num_chunks == 1) {
+    task->Run(begin, end);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = task;
+    begin_ = begin;
+    end_ = end;
+    chunk_size_ = chunk_size;
+    num_chunks_ = num_chunks;
+    next_chunk_.store(0);
+    busy_workers_ = workers_.size();
+    generation_++;
+  }
+  work_ready_.notify_all();
+
+  RunChunks();
+
+  // Wait for the workers to finish their last chunks.
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (busy_workers_ > 0) {
+    work_done_.wait(lock);
+  }
+  task_ = NULL;
+}
+
+int ThreadPool::HardwareThreads() {
+  int threads = std::thread::hardware_concurrency();
+  return (threads > 0) ? threads : 1;
+}
+
+void ThreadPool::WorkerLoop() {
+  int seen_generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!shutting_down_ && generation_ == seen_generation) {
+        work_ready_.wait(lock);
+      }
+      if (shutting_down_) {
+        return;
+      }
+      seen_generation = generation_;
+    }
+
+    RunChunks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_workers_--;
+    }
+    work_done_.notify_one();
+  }
+}
+
+void ThreadPool::RunChunks() {
+  while (true) {
+    int chunk = next_chunk_.fetch_add(1);
+    if (chunk >= num_chunks_) {
+      return;
+    }
+
+    int chunk_begin = begin_ + chunk * chunk_size_;
+    int chunk_end = chunk_begin + chunk_size_;
+    task_->Run(chunk_begin, (chunk_end < end_) ? chunk_end : end_);
+  }
+}
+}
@@ -0,0 +1,86 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_THREAD_POOL_H_
+#define SRC_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace computer_animation {
+
+//! \class ParallelTask
+//! \brief A piece of work over a range of indices, which a ThreadPool can
+//! split between threads.
+class ParallelTask {
+  public:
+    virtual ~ParallelTask() {}
+
+    //! \brief Performs the work for the indices in [begin, end).
+    //!
+    //! May be called concurrently for disjoint ranges.
+    virtual void Run(int begin, int end) = 0;
+};
+
+//! \class ThreadPool
+//! \brief A fixed set of worker threads that run ParallelTasks.
+//!
+//! The threads are created once, when the pool is created, and sleep
+//! between tasks. The thread that calls ParallelFor also does a share of
+//! the work, so a pool of n threads starts n - 1 workers.
+class ThreadPool {
+  public:
+    //! \brief Creates a pool that runs tasks on num_threads threads.
+    explicit ThreadPool(int num_threads);
+
+    ~ThreadPool();
+
+    //! \brief Returns the number of threads that tasks are run on.
+    inline int num_threads() const { return workers_.size() + 1; }
+
+    //! \brief Runs a task over [begin, end), and waits for it to finish.
+    //!
+    //! The range is split into chunks of chunk_size indices (the last chunk
+    //! may be smaller), which are handed out to the threads as they become
+    //! free. Chunks start at begin plus a multiple of chunk_size.
+    void ParallelFor(ParallelTask *task, int begin, int end, int chunk_size);
+
+    //! \brief Returns the number of threads the hardware can run at once.
+    static int HardwareThreads();
+
+  private:
+    // Copying is not allowed.
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    // The main loop of each worker thread.
+    void WorkerLoop();
+
+    // Runs chunks of the current task until there are none left.
+    void RunChunks();
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+
+    // The current task. Guarded by mutex_, apart from next_chunk_.
+    ParallelTask* task_;
+    int begin_;
+    int end_;
+    int chunk_size_;
+    int num_chunks_;
+    std::atomic<int> next_chunk_;
+
+    // Incremented for each task, so that workers can tell a new task from
+    // a spurious wake-up.
+    int generation_;
+    int busy_workers_;
+    bool shutting_down_;
+};
+}
+
+#endif  // SRC_THREAD_POOL_H_
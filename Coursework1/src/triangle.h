@@ -8,8 +8,9 @@ namespace computer_animation {
 //! \class Triangle
 //! \brief Represents a triangle.
 //!
-//! The triangle vertices are stored as indices into the TriangleMesh's
-//! list, as are the triangle edges.
+//! The triangle vertices and normals are stored as indices into the
+//! TriangleMesh's lists. The triangle's edges are kept by the TriangleMesh
+//! (see TriangleMesh::GetTriangleEdge).
 class Triangle {
   friend class TriangleMesh;
 
@@ -25,21 +26,19 @@ class Triangle {
       normals_[2] = n3;
     }
 
-    //! \brief Sets the edges of the triangle.
-    void SetEdges(int e1, int e2, int e3);
-
     //! \brief Gets the indices of the triangle vertices.
-    void GetVertexIndices(int *v1, int *v2, int *v3) {
+    void GetVertexIndices(int *v1, int *v2, int *v3) const {
       *v1 = vertices_[0];
       *v2 = vertices_[1];
       *v3 = vertices_[2];
     }
 
+    //! \brief Returns the indices of the three triangle vertices.
+    inline const int* vertex_indices() const { return vertices_; }
+
   private:
-    int id_;
     int vertices_[3];
     int normals_[3];
-    int edges_[3];
 };
 }
 
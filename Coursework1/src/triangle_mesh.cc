@@ -2,126 +2,243 @@
 
 #include "./triangle_mesh.h"
 
+#include <stdint.h>
+
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <string>
 
+#include "./aligned_array.h"
 #include "./cav_utils.h"
+#include "./mesh_cache.h"
+#include "./mesh_optimizer.h"
+#include "./obj_parser.h"
 
 namespace computer_animation {
 
-void TriangleMesh::LoadFile(char *filename) {
-  FILE *f;
-  f = fopen(filename, "r");
+namespace {
 
-  if (f == NULL) {
+// Orders influences so that the largest weight comes first.
+bool HeavierInfluence(const BoneInfluence &a, const BoneInfluence &b) {
+  return a.weight > b.weight;
+}
+
+// The number of arrays stored in a mesh cache.
+const int kNumCacheSections = 9;
+
+// Returns true if the num_values + 1 offsets start at 0, never decrease and
+// end at last.
+bool ValidOffsets(const int* offsets, int num_values, int last) {
+  if (offsets[0] != 0 || offsets[num_values] != last) {
+    return false;
+  }
+  for (int i = 0; i < num_values; i++) {
+    if (offsets[i + 1] < offsets[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if every one of the count indices is in [low, high).
+bool IndicesInRange(const int* indices, size_t count, int low, int high) {
+  for (size_t i = 0; i < count; i++) {
+    if (indices[i] < low || indices[i] >= high) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+void TriangleMesh::LoadFile(char *filename) {
+  ObjData data;
+  ThreadPool pool(ThreadPool::HardwareThreads());
+  if (!ParseObjFile(filename, &pool, &data)) {
     fprintf(stderr, "Error: Failed reading polygon data file %s\n", filename);
     exit(1);
   }
 
-  char buf[1024];
-  char header[100];
-  float x, y, z;
-  int v1, v2, v3;
+  int num_vertices = data.vertices.size();
+  int num_triangles = data.triangle_vertices.size() / 3;
 
-  while (fgets(buf, sizeof(buf), f) != NULL) {
-    if (buf[0] == 'v') {
-      // This is safe as buf is a bounded-size input.
-      sscanf(buf, "%s %f %f %f", header, &x, &y, &z);
-
-      mesh_vertices_.push_back(Vector3d<float>(x, y, z));
-
-      // Add a default normal.
-      mesh_normals_.push_back(Vector3d<float>(0.0f, 0.0f, 1.0f));
-    } else if (buf[0] == 'f') {
-      // This is safe as buf is a bounded-size input.
-      sscanf(buf, "%s %d %d %d", header, &v1, &v2, &v3);
-
-      // The normal indices are the same as the vertex ones.
-      Triangle triangle(v1 - 1, v2 - 1, v3 - 1, v1 - 1, v2 - 1, v3 - 1);
-
-      triangle.id_ = mesh_triangles_.size();
-      mesh_triangles_.push_back(triangle);
-
-      // Create the edges of the triangle.
-      Edge e1(v1 - 1, v2 - 1);
-      Edge e2(v2 - 1, v3 - 1);
-      Edge e3(v3 - 1, v1 - 1);
-      Edge edges[] = {e1, e2, e3};
-
-      int id1 = FindEdge(e1, mesh_edges_);
-      int id2 = FindEdge(e2, mesh_edges_);
-      int id3 = FindEdge(e3, mesh_edges_);
-      int edge_ids[] = {id1, id2, id3};
-
-      // If any of the edges don't exist, create them.
-      for (int i = 0; i < 3; i++) {
-        int id = edge_ids[i];
-        if (id >= 0) {
-          continue;
-        }
-
-        id = mesh_edges_.size();
-        edges[i].AddTriangle(triangle.id_);
-        mesh_edges_.push_back(edges[i]);
-
-        edge_ids[i] = id;
-      }
+  // The file's normals are only used if every face gives them, otherwise
+  // they are calculated from the faces below.
+  bool use_file_normals = !data.normals.empty();
+  for (unsigned int i = 0; use_file_normals &&
+       i < data.triangle_normals.size(); i++) {
+    use_file_normals = data.triangle_normals[i] >= 0 &&
+        data.triangle_normals[i] < static_cast<int>(data.normals.size());
+  }
 
-      id1 = edge_ids[0];
-      id2 = edge_ids[1];
-      id3 = edge_ids[2];
+  for (unsigned int i = 0; i < data.triangle_vertices.size(); i++) {
+    if (data.triangle_vertices[i] < 0 ||
+        data.triangle_vertices[i] >= num_vertices) {
+      fprintf(stderr, "Error: Face refers to missing vertex %d in %s\n",
+          data.triangle_vertices[i] + 1, filename);
+      exit(1);
+    }
+  }
 
-      mesh_edges_[id1].AddTriangle(triangle.id_);
-      mesh_edges_[id2].AddTriangle(triangle.id_);
-      mesh_edges_[id3].AddTriangle(triangle.id_);
+  std::vector<Triangle> triangles;
+  triangles.reserve(num_triangles);
+  for (int t = 0; t < num_triangles; t++) {
+    const int* corners = &data.triangle_vertices[3 * t];
+    const int* normals = use_file_normals ?
+        &data.triangle_normals[3 * t] : corners;
+    triangles.push_back(Triangle(corners[0], corners[1], corners[2],
+        normals[0], normals[1], normals[2]));
+  }
 
-      mesh_triangles_[mesh_triangles_.size()-1].SetEdges(id1, id2, id3);
-    }
+  mesh_vertices_.Assign(&data.vertices);
+  SetTriangles(&triangles);
+
+  if (use_file_normals) {
+    mesh_normals_.Assign(&data.normals);
+  } else {
+    ComputeNormals();
+  }
+}
+
+void TriangleMesh::SetMesh(std::vector<Vector3d<float> > *vertices,
+    const std::vector<int> &triangle_vertices,
+    std::vector<int> *influence_offsets,
+    std::vector<BoneInfluence> *influences) {
+  std::vector<Triangle> triangles;
+  triangles.reserve(triangle_vertices.size() / 3);
+  for (unsigned int t = 0; t < triangle_vertices.size() / 3; t++) {
+    const int* corners = &triangle_vertices[3 * t];
+    triangles.push_back(Triangle(corners[0], corners[1], corners[2],
+        corners[0], corners[1], corners[2]));
   }
 
-  std::vector<std::vector<int> > faces(mesh_vertices_.size());
-  std::vector<Vector3d<float> > face_norms(mesh_triangles_.size());
+  mesh_vertices_.Assign(vertices);
+  SetTriangles(&triangles);
+  ComputeNormals();
+  influence_offsets_.Assign(influence_offsets);
+  influences_.Assign(influences);
+}
 
-  for (unsigned int i = 0; i < mesh_triangles_.size(); i++)  {
+void TriangleMesh::ComputeNormals() {
+  int num_vertices = mesh_vertices_.size();
+  int num_triangles = mesh_triangles_.size();
+  std::vector<Vector3d<float> > face_norms(num_triangles);
+  std::vector<Vector3d<float> > normals(num_vertices,
+      Vector3d<float>(0.0f, 0.0f, 1.0f));
+
+  for (int i = 0; i < num_triangles; i++)  {
+    const Triangle &triangle = mesh_triangles_[i];
     Vector3d<float> face_normal = CrossProduct(
-        (mesh_vertices_[mesh_triangles_[i].vertices_[2]] -
-            mesh_vertices_[mesh_triangles_[i].vertices_[0]]),
-        (mesh_vertices_[mesh_triangles_[i].vertices_[1]] -
-            mesh_vertices_[mesh_triangles_[i].vertices_[0]]));
+        (mesh_vertices_[triangle.vertices_[2]] -
+            mesh_vertices_[triangle.vertices_[0]]),
+        (mesh_vertices_[triangle.vertices_[1]] -
+            mesh_vertices_[triangle.vertices_[0]]));
     face_normal.Normalize();
-    face_norms.at(i) = face_normal;
-
-    faces[mesh_triangles_[i].vertices_[0]].push_back(i);
-    faces[mesh_triangles_[i].vertices_[1]].push_back(i);
-    faces[mesh_triangles_[i].vertices_[2]].push_back(i);
+    face_norms[i] = face_normal;
   }
 
-  for (unsigned int i = 0; i < mesh_vertices_.size(); i++) {
+  for (int i = 0; i < num_vertices; i++) {
+    const int* faces = GetVertexFaces(i);
+    int num_faces = GetNumberOfVertexFaces(i);
+    if (num_faces == 0) {
+      continue;
+    }
+
     Vector3d<float> N(0.0f, 0.0f, 0.0f);
+    for (int j = 0; j < num_faces; j++) {
+      N += face_norms[faces[j]];
+    }
 
-    float rate1, rate2;
+    N /= static_cast<float>(num_faces);
 
-    if (mesh_vertices_[i][1] > 0.5) {
-      rate1 = 1.0f;
-      rate2 = 0.0f;
-    } else if (mesh_vertices_[i][1] < -0.5) {
-      rate1 = 0.0f;
-      rate2 = 1.0f;
-    } else {
-      rate1 = mesh_vertices_[i][1] + 0.5f;
-      rate2 = 1.0f - rate1;
-    }
+    normals[i] = N;
+  }
+
+  mesh_normals_.Assign(&normals);
+}
 
-    for (unsigned int j = 0; j < faces[i].size(); j++) {
-      N += face_norms[faces[i][j]];
+void TriangleMesh::SetTriangles(std::vector<Triangle> *triangles) {
+  int num_vertices = mesh_vertices_.size();
+  int num_triangles = triangles->size();
+
+  // Sort the sides of the triangles by their lower vertex, so that the
+  // sides along the same edge end up in the same bucket, then give each
+  // distinct edge in a bucket an index. Side i of triangle t runs from its
+  // i-th vertex to the next, and is numbered 3t + i.
+  std::vector<int> side_offsets(num_vertices + 1, 0);
+  for (int t = 0; t < num_triangles; t++) {
+    const int* vertices = (*triangles)[t].vertices_;
+    for (int i = 0; i < 3; i++) {
+      side_offsets[std::min(vertices[i], vertices[(i + 1) % 3]) + 1]++;
     }
+  }
+  for (int i = 0; i < num_vertices; i++) {
+    side_offsets[i + 1] += side_offsets[i];
+  }
+  std::vector<int> sides(3 * num_triangles);
+  std::vector<int> next_side(side_offsets.begin(), side_offsets.end() - 1);
+  for (int t = 0; t < num_triangles; t++) {
+    const int* vertices = (*triangles)[t].vertices_;
+    for (int i = 0; i < 3; i++) {
+      sides[next_side[std::min(vertices[i], vertices[(i + 1) % 3])]++] =
+          3 * t + i;
+    }
+  }
+
+  // A vertex only has a handful of sides, so the edges in a bucket are
+  // found by searching the ones made for it so far.
+  std::vector<Edge> edges;
+  edges.reserve(num_triangles * 3 / 2 + 1);
+  std::vector<int> triangle_edges(3 * num_triangles);
+  for (int v = 0; v < num_vertices; v++) {
+    int first_edge = edges.size();
+    for (int s = side_offsets[v]; s < side_offsets[v + 1]; s++) {
+      int t = sides[s] / 3;
+      int i = sides[s] % 3;
+      int a = (*triangles)[t].vertices_[i];
+      int b = (*triangles)[t].vertices_[(i + 1) % 3];
+      int high = std::max(a, b);
+
+      int e = first_edge;
+      while (e < static_cast<int>(edges.size()) &&
+             edges[e].v1() + edges[e].v2() - v != high) {
+        e++;
+      }
+      if (e == static_cast<int>(edges.size())) {
+        edges.push_back(Edge(a, b));
+      }
 
-    N /= static_cast<float>(faces[i].size());
+      triangle_edges[sides[s]] = e;
+      edges[e].AddTriangle(t);
+    }
+  }
 
-    mesh_normals_[i] = N;
+  // Index the faces around each vertex, by counting the faces of each
+  // vertex and then filling in their ids.
+  std::vector<int> vertex_face_offsets(num_vertices + 1, 0);
+  for (int t = 0; t < num_triangles; t++) {
+    for (int i = 0; i < 3; i++) {
+      vertex_face_offsets[(*triangles)[t].vertices_[i] + 1]++;
+    }
+  }
+  for (int i = 0; i < num_vertices; i++) {
+    vertex_face_offsets[i + 1] += vertex_face_offsets[i];
+  }
+  std::vector<int> vertex_faces(3 * num_triangles);
+  std::vector<int> next_face(vertex_face_offsets.begin(),
+      vertex_face_offsets.end() - 1);
+  for (int t = 0; t < num_triangles; t++) {
+    for (int i = 0; i < 3; i++) {
+      vertex_faces[next_face[(*triangles)[t].vertices_[i]]++] = t;
+    }
   }
 
-  fclose(f);
+  mesh_triangles_.Assign(triangles);
+  mesh_edges_.Assign(&edges);
+  triangle_edges_.Assign(&triangle_edges);
+  vertex_face_offsets_.Assign(&vertex_face_offsets);
+  vertex_faces_.Assign(&vertex_faces);
 }
 
 void TriangleMesh::LoadWeights(char *filename) {
@@ -134,6 +251,9 @@ void TriangleMesh::LoadWeights(char *filename) {
   }
 
   char buf[1024];
+  std::vector<BoneInfluence> vertex_influences;
+  std::vector<int> influence_offsets(1, 0);
+  std::vector<BoneInfluence> influences;
 
   while (fgets(buf, sizeof(buf), f) != NULL) {
     // Remove newlines.
@@ -142,21 +262,406 @@ void TriangleMesh::LoadWeights(char *filename) {
       *p = '\0';
     }
 
-    // The root 'bone' has no weight on anything.
-    bone_weights_.at(0).push_back(0.0);
+    // The root 'bone' has no weight on anything, so the first weight is for
+    // bone 1.
+    vertex_influences.clear();
     int i = 1;
     char *token;
     char *sp;
     token = strtok_r(buf, " ", &sp);
     while (token != NULL) {
       float weight = atof(token);
-      bone_weights_.at(i).push_back(weight);
+      if (weight > 0.0f) {
+        BoneInfluence influence = {i, weight};
+        vertex_influences.push_back(influence);
+      }
 
       token = strtok_r(NULL, " ", &sp);
       i++;
     }
+
+    // Keep only the heaviest influences, and rescale them to sum to one.
+    std::sort(vertex_influences.begin(), vertex_influences.end(),
+        HeavierInfluence);
+    if (static_cast<int>(vertex_influences.size()) > max_influences_) {
+      vertex_influences.resize(max_influences_);
+    }
+
+    float total_weight = 0.0f;
+    for (unsigned int j = 0; j < vertex_influences.size(); j++) {
+      total_weight += vertex_influences[j].weight;
+    }
+    for (unsigned int j = 0; j < vertex_influences.size(); j++) {
+      vertex_influences[j].weight /= total_weight;
+      influences.push_back(vertex_influences[j]);
+    }
+    influence_offsets.push_back(influences.size());
   }
 
   fclose(f);
+
+  // Every vertex needs a line, or its influences would be read from past
+  // the end of the arrays.
+  if (static_cast<int>(influence_offsets.size()) !=
+      GetNumberOfVertices() + 1) {
+    fprintf(stderr, "Error: Weights data file %s has %d lines, but the mesh "
+        "has %d vertices\n", filename,
+        static_cast<int>(influence_offsets.size()) - 1, GetNumberOfVertices());
+    exit(1);
+  }
+
+  influence_offsets_.Assign(&influence_offsets);
+  influences_.Assign(&influences);
+}
+
+void TriangleMesh::LoadWithCache(char *object_file, char *weights_file,
+    const char *cache_file) {
+  uint64_t source_hash;
+  if (!HashMeshSources(object_file, weights_file, max_influences_,
+          optimize_vertex_order_, &source_hash)) {
+    fprintf(stderr, "Error: Failed reading mesh files %s and %s\n",
+        object_file, weights_file);
+    exit(1);
+  }
+
+  if (LoadCache(cache_file, source_hash)) {
+    return;
+  }
+
+  // LoadWeights() exits if the weights do not match the vertices, so a
+  // cache is only written for a mesh that is whole.
+  LoadFile(object_file);
+  LoadWeights(weights_file);
+  if (optimize_vertex_order_) {
+    OptimizeVertexOrder(NULL, NULL);
+  }
+  if (!WriteCache(cache_file, source_hash)) {
+    fprintf(stderr, "Warning: Failed writing mesh cache %s\n", cache_file);
+  }
+}
+
+bool TriangleMesh::LoadCache(const char *filename, uint64_t source_hash) {
+  MappedFile file;
+  if (!file.Open(filename) || file.size() < sizeof(MeshCacheHeader)) {
+    return false;
+  }
+
+  MeshCacheHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, "CAVM", 4) != 0 ||
+      header.version != kMeshCacheVersion ||
+      header.source_hash != source_hash ||
+      header.file_size != file.size()) {
+    return false;
+  }
+
+  // Check that every section lies within the file and is aligned.
+  const uint64_t offsets[] = {header.vertices_offset, header.normals_offset,
+      header.triangles_offset, header.edges_offset,
+      header.triangle_edges_offset,
+      header.influence_offsets_offset, header.influences_offset,
+      header.vertex_face_offsets_offset, header.vertex_faces_offset};
+  const uint64_t sizes[] = {
+      header.num_vertices * sizeof(Vector3d<float>),
+      header.num_normals * sizeof(Vector3d<float>),
+      header.num_triangles * sizeof(Triangle),
+      header.num_edges * sizeof(Edge),
+      header.num_triangles * 3ULL * sizeof(int),
+      (header.num_vertices + 1ULL) * sizeof(int),
+      header.num_influences * sizeof(BoneInfluence),
+      (header.num_vertices + 1ULL) * sizeof(int),
+      header.num_vertex_faces * sizeof(int)};
+  for (int i = 0; i < kNumCacheSections; i++) {
+    if (offsets[i] % kCacheLineSize != 0 || offsets[i] > file.size() ||
+        sizes[i] > file.size() - offsets[i]) {
+      return false;
+    }
+  }
+
+  // Check every index once here, so that the arrays can be used without
+  // bounds checks however the file was damaged. Bones are checked against
+  // the skeleton once it is known.
+  const char* data = file.data();
+  int num_vertices = header.num_vertices;
+  int num_triangles = header.num_triangles;
+  const int* influence_offsets =
+      reinterpret_cast<const int*>(data + header.influence_offsets_offset);
+  const int* vertex_face_offsets =
+      reinterpret_cast<const int*>(data + header.vertex_face_offsets_offset);
+  if (!ValidOffsets(influence_offsets, num_vertices, header.num_influences) ||
+      !ValidOffsets(vertex_face_offsets, num_vertices,
+          header.num_vertex_faces) ||
+      !IndicesInRange(reinterpret_cast<const int*>(
+          data + header.vertex_faces_offset), header.num_vertex_faces, 0,
+          num_triangles)) {
+    return false;
+  }
+  const Triangle* triangles =
+      reinterpret_cast<const Triangle*>(data + header.triangles_offset);
+  for (int t = 0; t < num_triangles; t++) {
+    if (!IndicesInRange(triangles[t].vertices_, 3, 0, num_vertices) ||
+        !IndicesInRange(triangles[t].normals_, 3, 0, header.num_normals)) {
+      return false;
+    }
+  }
+  const Edge* edges =
+      reinterpret_cast<const Edge*>(data + header.edges_offset);
+  for (uint32_t e = 0; e < header.num_edges; e++) {
+    // Missing triangles are stored as -1.
+    if (edges[e].v1() < 0 || edges[e].v1() >= num_vertices ||
+        edges[e].v2() < 0 || edges[e].v2() >= num_vertices ||
+        edges[e].triangle(0) < -1 || edges[e].triangle(0) >= num_triangles ||
+        edges[e].triangle(1) < -1 || edges[e].triangle(1) >= num_triangles) {
+      return false;
+    }
+  }
+  const int* triangle_edges =
+      reinterpret_cast<const int*>(data + header.triangle_edges_offset);
+  if (!IndicesInRange(triangle_edges, 3ULL * num_triangles, 0,
+          header.num_edges)) {
+    return false;
+  }
+  const BoneInfluence* influences =
+      reinterpret_cast<const BoneInfluence*>(data + header.influences_offset);
+  for (uint32_t i = 0; i < header.num_influences; i++) {
+    if (influences[i].bone < 0) {
+      return false;
+    }
+  }
+
+  mesh_vertices_.Borrow(reinterpret_cast<const Vector3d<float>*>(
+      data + header.vertices_offset), header.num_vertices);
+  mesh_normals_.Borrow(reinterpret_cast<const Vector3d<float>*>(
+      data + header.normals_offset), header.num_normals);
+  mesh_triangles_.Borrow(triangles, header.num_triangles);
+  influence_offsets_.Borrow(influence_offsets, header.num_vertices + 1);
+  influences_.Borrow(influences, header.num_influences);
+  vertex_face_offsets_.Borrow(vertex_face_offsets, header.num_vertices + 1);
+  vertex_faces_.Borrow(reinterpret_cast<const int*>(
+      data + header.vertex_faces_offset), header.num_vertex_faces);
+  mesh_edges_.Borrow(edges, header.num_edges);
+  triangle_edges_.Borrow(triangle_edges, 3 * header.num_triangles);
+
+  // Keep the file mapped for as long as the arrays refer to it.
+  cache_file_.Swap(&file);
+  return true;
+}
+
+bool TriangleMesh::WriteCache(const char *filename,
+    uint64_t source_hash) const {
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "CAVM", 4);
+  header.version = kMeshCacheVersion;
+  header.source_hash = source_hash;
+  header.num_vertices = mesh_vertices_.size();
+  header.num_normals = mesh_normals_.size();
+  header.num_triangles = mesh_triangles_.size();
+  header.num_edges = mesh_edges_.size();
+  header.num_influences = influences_.size();
+  header.num_vertex_faces = vertex_faces_.size();
+
+  // Lay the sections out one after another, each on a cache line boundary.
+  const void* sections[] = {mesh_vertices_.data(), mesh_normals_.data(),
+      mesh_triangles_.data(), mesh_edges_.data(), triangle_edges_.data(),
+      influence_offsets_.data(), influences_.data(),
+      vertex_face_offsets_.data(), vertex_faces_.data()};
+  const size_t sizes[] = {
+      mesh_vertices_.size() * sizeof(Vector3d<float>),
+      mesh_normals_.size() * sizeof(Vector3d<float>),
+      mesh_triangles_.size() * sizeof(Triangle),
+      mesh_edges_.size() * sizeof(Edge),
+      triangle_edges_.size() * sizeof(int),
+      influence_offsets_.size() * sizeof(int),
+      influences_.size() * sizeof(BoneInfluence),
+      vertex_face_offsets_.size() * sizeof(int),
+      vertex_faces_.size() * sizeof(int)};
+  uint64_t* offsets[] = {&header.vertices_offset, &header.normals_offset,
+      &header.triangles_offset, &header.edges_offset,
+      &header.triangle_edges_offset, &header.influence_offsets_offset,
+      &header.influences_offset,
+      &header.vertex_face_offsets_offset, &header.vertex_faces_offset};
+
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < kNumCacheSections; i++) {
+    offset = (offset + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+    *offsets[i] = offset;
+    offset += sizes[i];
+  }
+  header.file_size = offset;
+
+  // Write to a temporary file and rename it into place, so that a reader
+  // never sees a partly written cache.
+  std::string temporary_filename = std::string(filename) + ".tmp";
+  FILE *f = fopen(temporary_filename.c_str(), "wb");
+  if (f == NULL) {
+    return false;
+  }
+
+  static const char kZeroes[kCacheLineSize] = {0};
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  uint64_t written = sizeof(header);
+  for (int i = 0; i < kNumCacheSections && ok; i++) {
+    ok = fwrite(kZeroes, 1, *offsets[i] - written, f) == *offsets[i] - written
+        && fwrite(sections[i], 1, sizes[i], f) == sizes[i];
+    written = *offsets[i] + sizes[i];
+  }
+
+  if (fclose(f) != 0 || !ok ||
+      rename(temporary_filename.c_str(), filename) != 0) {
+    remove(temporary_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+void TriangleMesh::OptimizeVertexOrder(float *acmr_before,
+    float *acmr_after) {
+  int num_vertices = mesh_vertices_.size();
+  int num_triangles = mesh_triangles_.size();
+
+  std::vector<int> indices(3 * num_triangles);
+  for (int t = 0; t < num_triangles; t++) {
+    for (int i = 0; i < 3; i++) {
+      indices[3 * t + i] = mesh_triangles_[t].vertices_[i];
+    }
+  }
+  if (acmr_before != NULL) {
+    *acmr_before = ComputeAcmr(indices.data(), num_triangles, num_vertices);
+  }
+
+  std::vector<int> order;
+  OptimizeTriangleOrder(indices.data(), num_triangles, num_vertices, &order);
+
+  // Number the vertices in the order the triangles first use them. Any
+  // vertices that no triangle uses go at the end, in their old order.
+  std::vector<int> new_index(num_vertices, -1);
+  std::vector<int> old_index;
+  old_index.reserve(num_vertices);
+  for (int t = 0; t < num_triangles; t++) {
+    for (int i = 0; i < 3; i++) {
+      int vertex = indices[3 * order[t] + i];
+      if (new_index[vertex] < 0) {
+        new_index[vertex] = old_index.size();
+        old_index.push_back(vertex);
+      }
+    }
+  }
+  for (int v = 0; v < num_vertices; v++) {
+    if (new_index[v] < 0) {
+      new_index[v] = old_index.size();
+      old_index.push_back(v);
+    }
+  }
+
+  // Normals that are shared with the vertex indices move with the
+  // vertices; normals from the file are indexed separately, so stay put.
+  bool normals_per_vertex =
+      static_cast<int>(mesh_normals_.size()) == num_vertices;
+  for (int t = 0; normals_per_vertex && t < num_triangles; t++) {
+    for (int i = 0; i < 3; i++) {
+      normals_per_vertex = normals_per_vertex &&
+          mesh_triangles_[t].normals_[i] == mesh_triangles_[t].vertices_[i];
+    }
+  }
+
+  std::vector<Triangle> triangles;
+  triangles.reserve(num_triangles);
+  for (int t = 0; t < num_triangles; t++) {
+    const Triangle &old = mesh_triangles_[order[t]];
+    const int* normals = old.normals_;
+    int vertices[3];
+    int new_normals[3];
+    for (int i = 0; i < 3; i++) {
+      vertices[i] = new_index[old.vertices_[i]];
+      new_normals[i] = normals_per_vertex ? vertices[i] : normals[i];
+    }
+    triangles.push_back(Triangle(vertices[0], vertices[1], vertices[2],
+        new_normals[0], new_normals[1], new_normals[2]));
+  }
+
+  std::vector<Vector3d<float> > vertices(num_vertices);
+  for (int v = 0; v < num_vertices; v++) {
+    vertices[v] = mesh_vertices_[old_index[v]];
+  }
+  if (normals_per_vertex) {
+    std::vector<Vector3d<float> > normals(num_vertices);
+    for (int v = 0; v < num_vertices; v++) {
+      normals[v] = mesh_normals_[old_index[v]];
+    }
+    mesh_normals_.Assign(&normals);
+  }
+
+  // Move each vertex's bone influences, if the weights are loaded.
+  if (static_cast<int>(influence_offsets_.size()) == num_vertices + 1) {
+    std::vector<int> influence_offsets(1, 0);
+    std::vector<BoneInfluence> influences;
+    influence_offsets.reserve(num_vertices + 1);
+    influences.reserve(influences_.size());
+    for (int v = 0; v < num_vertices; v++) {
+      const BoneInfluence* first = GetInfluences(old_index[v]);
+      influences.insert(influences.end(), first,
+          first + GetNumberOfInfluences(old_index[v]));
+      influence_offsets.push_back(influences.size());
+    }
+    influence_offsets_.Assign(&influence_offsets);
+    influences_.Assign(&influences);
+  }
+
+  mesh_vertices_.Assign(&vertices);
+  SetTriangles(&triangles);
+
+  if (acmr_after != NULL) {
+    *acmr_after = GetAcmr();
+  }
+}
+
+float TriangleMesh::GetAcmr() const {
+  int num_triangles = mesh_triangles_.size();
+  std::vector<int> indices(3 * num_triangles);
+  for (int t = 0; t < num_triangles; t++) {
+    for (int i = 0; i < 3; i++) {
+      indices[3 * t + i] = mesh_triangles_[t].vertices_[i];
+    }
+  }
+  return ComputeAcmr(indices.data(), num_triangles, mesh_vertices_.size());
+}
+
+size_t TriangleMesh::GetConnectivityBytes() const {
+  return mesh_triangles_.size() * sizeof(Triangle) +
+      mesh_edges_.size() * sizeof(Edge) +
+      triangle_edges_.size() * sizeof(int);
+}
+
+bool TriangleMesh::LoadSkeleton(const char *filename) {
+  Skeleton skeleton;
+  if (!skeleton.Load(filename)) {
+    return false;
+  }
+
+  // Skinning indexes the skeleton's matrices by the weights' bones, so
+  // they have to be checked before the two are used together.
+  for (size_t i = 0; i < influences_.size(); i++) {
+    if (influences_[i].bone >= skeleton.GetNumberBones()) {
+      fprintf(stderr, "Error: The weights use bone %d, but skeleton file %s "
+          "only has %d bones\n", influences_[i].bone, filename,
+          skeleton.GetNumberBones());
+      return false;
+    }
+  }
+
+  skeleton_ = skeleton;
+  return true;
+}
+
+const float TriangleMesh::GetBoneWeight(int b, int w) const {
+  const BoneInfluence* influences = GetInfluences(w);
+  int num_influences = GetNumberOfInfluences(w);
+  for (int i = 0; i < num_influences; i++) {
+    if (influences[i].bone == b) {
+      return influences[i].weight;
+    }
+  }
+  return 0.0f;
 }
 }
@@ -3,39 +3,152 @@
 #ifndef SRC_TRIANGLE_MESH_H_
 #define SRC_TRIANGLE_MESH_H_
 
+#include <stdint.h>
+
 #include <cstdio>
 #include <vector>
 
+#include "./array_view.h"
 #include "./edge.h"
+#include "./mapped_file.h"
+#include "./mesh_array.h"
 #include "./skeleton.h"
 #include "./triangle.h"
 
 namespace computer_animation {
 
+//! \brief The default maximum number of bones that may influence a vertex.
+const int kDefaultMaxInfluences = 4;
+
+//! \struct BoneInfluence
+//! \brief The weight that a single bone has on a vertex.
+struct BoneInfluence {
+  int bone;
+  float weight;
+};
+
 //! \class TriangleMesh
 //! \brief Represents a polygon implemented as a mesh of triangles.
 class TriangleMesh {
   public:
-    TriangleMesh() {
-      bone_weights_.resize(skeleton_.GetNumberBones());
+    TriangleMesh()
+        : max_influences_(kDefaultMaxInfluences),
+          optimize_vertex_order_(false) {
     }
 
     //! \brief Loads in an object file and populates the mesh from it.
     void LoadFile(char *filename);
 
     //! \brief Loads in a weights file.
+    //!
+    //! The file holds one line per vertex, with one weight per non-root bone.
+    //! Only the non-zero weights are kept: each vertex keeps its largest
+    //! max_influences() weights, rescaled so that they sum to one. Must be
+    //! called after LoadFile(); exits if the file does not have a line for
+    //! every vertex.
     void LoadWeights(char *filename);
 
+    //! \brief Replaces the mesh with new vertices, triangles and bone
+    //! influences.
+    //!
+    //! triangle_vertices holds three vertex indices per triangle, and the
+    //! influences are laid out as GetInfluences() returns them. The normals
+    //! and edges are computed as LoadFile() computes them. The vectors
+    //! passed by pointer are left empty.
+    void SetMesh(std::vector<Vector3d<float> > *vertices,
+        const std::vector<int> &triangle_vertices,
+        std::vector<int> *influence_offsets,
+        std::vector<BoneInfluence> *influences);
+
+    //! \brief Loads an object file and a weights file through a mesh cache.
+    //!
+    //! If cache_file is up to date with the two source files it is mapped
+    //! and used in place. Otherwise the sources are loaded with LoadFile and
+    //! LoadWeights, optimized with OptimizeVertexOrder() if
+    //! optimize_vertex_order() is set, and cache_file is rewritten for next
+    //! time. Failing to write the cache is only a warning.
+    void LoadWithCache(char *object_file, char *weights_file,
+        const char *cache_file);
+
+    //! \brief Maps a mesh cache and uses its arrays in place.
+    //!
+    //! Returns false, leaving the mesh unchanged, if the file is missing,
+    //! malformed, of another version or its source hash differs from
+    //! source_hash.
+    bool LoadCache(const char *filename, uint64_t source_hash);
+
+    //! \brief Writes the mesh and its weights out as a mesh cache.
+    //!
+    //! Returns false if the file cannot be written.
+    bool WriteCache(const char *filename, uint64_t source_hash) const;
+
+    //! \brief Reorders the mesh for the post-transform vertex cache and for
+    //! memory locality.
+    //!
+    //! The triangles are reordered for vertex cache reuse (see
+    //! OptimizeTriangleOrder), then the vertices are renumbered in the order
+    //! that the triangles first use them, so that neighbouring triangles use
+    //! nearby vertices. The normals and bone weights are moved to match and
+    //! the edges are rebuilt. Should be called after LoadWeights(), as
+    //! weights loaded later would be in the old vertex order.
+    //!
+    //! The ACMR of the triangles before and after is returned through
+    //! acmr_before and acmr_after, if they are not NULL.
+    void OptimizeVertexOrder(float *acmr_before, float *acmr_after);
+
+    //! \brief Returns the ACMR of the mesh's triangles, as drawn in order.
+    float GetAcmr() const;
+
+    //! \brief Returns whether LoadWithCache() optimizes the vertex order.
+    inline bool optimize_vertex_order() const {
+      return optimize_vertex_order_;
+    }
+
+    //! \brief Sets whether LoadWithCache() optimizes the vertex order.
+    void SetOptimizeVertexOrder(bool optimize) {
+      optimize_vertex_order_ = optimize;
+    }
+
+    //! \brief Returns the maximum number of bones that may influence a
+    //! vertex.
+    inline int max_influences() const { return max_influences_; }
+
+    //! \brief Sets the maximum number of bones that may influence a vertex.
+    //!
+    //! Only affects weights files loaded after the call.
+    void SetMaxInfluences(int max_influences) {
+      max_influences_ = max_influences;
+    }
+
     //! \brief Returns the i-th vertex of the mesh.
-    Vector3d<float> GetVertex(int i) const {
+    inline const Vector3d<float>& GetVertex(int i) const {
       return mesh_vertices_[i];
     }
 
-    //! \brief Returns the i-th vertex of the mesh.
-    Triangle GetTriangle(int i) {
+    //! \brief Returns the i-th triangle of the mesh.
+    inline const Triangle& GetTriangle(int i) const {
       return mesh_triangles_[i];
     }
 
+    //! \brief Returns every vertex of the mesh.
+    //!
+    //! Like the other views of the mesh, this refers to the mesh's own
+    //! storage, so is only valid until the mesh is next changed.
+    inline ArrayView<Vector3d<float> > vertices() const {
+      return mesh_vertices_.view();
+    }
+
+    //! \brief Returns every normal of the mesh, indexed by the triangles'
+    //! normal indices.
+    inline ArrayView<Vector3d<float> > normals() const {
+      return mesh_normals_.view();
+    }
+
+    //! \brief Returns every triangle of the mesh.
+    inline ArrayView<Triangle> triangles() const {
+      return mesh_triangles_.view();
+    }
+
     //! \brief Returns the normals of the vertices for the i-th triangle.
     void GetTriangleNormals(int i, Vector3d<float> *v1, Vector3d<float> *v2,
         Vector3d<float> *v3) {
@@ -54,24 +167,126 @@ class TriangleMesh {
       return mesh_triangles_.size();
     }
 
+    //! \brief Returns the i-th distinct edge of the mesh.
+    inline const Edge& GetEdge(int i) const {
+      return mesh_edges_[i];
+    }
+
+    //! \brief Returns the number of distinct edges in the mesh.
+    inline const int GetNumberOfEdges() const {
+      return mesh_edges_.size();
+    }
+
+    //! \brief Returns the index of the i-th edge of triangle t, which runs
+    //! from its i-th vertex to the next.
+    inline int GetTriangleEdge(int t, int i) const {
+      return triangle_edges_[3 * t + i];
+    }
+
+    //! \brief Returns the triangle across the i-th edge of triangle t, or -1
+    //! if that edge is on the boundary.
+    inline int GetNeighbourTriangle(int t, int i) const {
+      return mesh_edges_[triangle_edges_[3 * t + i]].OtherTriangle(t);
+    }
+
+    //! \brief Returns the number of bytes used by the triangles, the edges
+    //! and the index of the edges of each triangle.
+    size_t GetConnectivityBytes() const;
+
     //! \brief Returns the object's skeleton.
     inline Skeleton* skeleton() { return &skeleton_; }
 
+    //! \brief Returns the object's skeleton.
+    inline const Skeleton* skeleton() const { return &skeleton_; }
+
     //! \brief Sets the object's skeleton.
-    void SetSkeleton(Skeleton skeleton) { skeleton_ = skeleton; }
+    void SetSkeleton(const Skeleton &skeleton) { skeleton_ = skeleton; }
+
+    //! \brief Loads the skeleton that the object is rigged to from a file
+    //! (see Skeleton::Load()), and makes it the object's skeleton.
+    //!
+    //! The weights must be loaded first. Returns false, printing an error
+    //! and leaving the object's skeleton alone, if the file cannot be
+    //! loaded or the weights use a bone that the skeleton does not have.
+    bool LoadSkeleton(const char *filename);
 
     //! \brief Gets the weight for bone b and vertex w.
-    const float GetBoneWeight(int b, int w) {
-      return bone_weights_.at(b).at(w);
+    const float GetBoneWeight(int b, int w) const;
+
+    //! \brief Returns the number of bones that influence the i-th vertex.
+    inline int GetNumberOfInfluences(int i) const {
+      return influence_offsets_[i + 1] - influence_offsets_[i];
+    }
+
+    //! \brief Returns the bones that influence the i-th vertex.
+    //!
+    //! There are GetNumberOfInfluences(i) entries, largest weight first.
+    inline const BoneInfluence* GetInfluences(int i) const {
+      return influences_.data() + influence_offsets_[i];
+    }
+
+    //! \brief Returns the bones that influence the i-th vertex, largest
+    //! weight first.
+    inline ArrayView<BoneInfluence> influences(int i) const {
+      return ArrayView<BoneInfluence>(GetInfluences(i),
+          GetNumberOfInfluences(i));
+    }
+
+    //! \brief Returns the number of triangles that use the i-th vertex.
+    inline int GetNumberOfVertexFaces(int i) const {
+      return vertex_face_offsets_[i + 1] - vertex_face_offsets_[i];
+    }
+
+    //! \brief Returns the indices of the triangles that use the i-th
+    //! vertex.
+    //!
+    //! There are GetNumberOfVertexFaces(i) entries, in increasing order.
+    inline const int* GetVertexFaces(int i) const {
+      return vertex_faces_.data() + vertex_face_offsets_[i];
+    }
+
+    //! \brief Returns the indices of the triangles that use the i-th
+    //! vertex, in increasing order.
+    inline ArrayView<int> vertex_faces(int i) const {
+      return ArrayView<int>(GetVertexFaces(i), GetNumberOfVertexFaces(i));
     }
 
   private:
+    // Takes a new set of triangles for the current vertices, rebuilding the
+    // edges, the edges of each triangle and the index of the triangles
+    // around each vertex.
+    void SetTriangles(std::vector<Triangle> *triangles);
+
+    // Computes a normal for each vertex by averaging the normals of the
+    // triangles around it.
+    void ComputeNormals();
+
     Skeleton skeleton_;
-    std::vector<Vector3d<float> > mesh_vertices_;
-    std::vector<Vector3d<float> > mesh_normals_;
-    std::vector<Triangle> mesh_triangles_;
-    std::vector<Edge> mesh_edges_;
-    std::vector<std::vector<float> > bone_weights_;
+
+    // The mesh data is either owned by the mesh or, when it was loaded from
+    // a cache, stored in cache_file_.
+    MeshArray<Vector3d<float> > mesh_vertices_;
+    MeshArray<Vector3d<float> > mesh_normals_;
+    MeshArray<Triangle> mesh_triangles_;
+    MeshArray<Edge> mesh_edges_;
+
+    // The three edges of every triangle, in the order of its vertices.
+    MeshArray<int> triangle_edges_;
+
+    // The bone influences of every vertex, stored back to back. The
+    // influences of vertex i are those in [influence_offsets_[i],
+    // influence_offsets_[i + 1]).
+    MeshArray<int> influence_offsets_;
+    MeshArray<BoneInfluence> influences_;
+    int max_influences_;
+    bool optimize_vertex_order_;
+
+    // The triangles around every vertex, stored the same way as the bone
+    // influences.
+    MeshArray<int> vertex_face_offsets_;
+    MeshArray<int> vertex_faces_;
+
+    MappedFile cache_file_;
 };
 }
 
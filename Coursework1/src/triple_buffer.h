@@ -0,0 +1,83 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_TRIPLE_BUFFER_H_
+#define SRC_TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+namespace computer_animation {
+
+//! \class TripleBuffer
+//! \brief Hands the newest of a stream of values from one thread to
+//! another without locking.
+//!
+//! There are three slots. The writer fills the back slot and publishes it,
+//! which swaps it with the middle slot; the reader takes the middle slot,
+//! if anything has been published since it last looked, by swapping it
+//! with the front slot. Neither ever waits for the other, and the reader
+//! always gets the newest value published: values published while the
+//! reader was not looking are overwritten, not queued.
+//!
+//! The slots are never copied, so a value that owns buffers keeps them
+//! from one use of its slot to the next. Exactly one thread may write and
+//! one read. The atomic operations are sequentially consistent, so that
+//! HasUpdate() can be used to decide whether to sleep.
+template <typename T>
+class TripleBuffer {
+  public:
+    TripleBuffer() : back_(0), front_(2), middle_(1) {}
+
+    //! \brief Returns the slot the writer fills next.
+    inline T* back() { return &slots_[back_]; }
+
+    //! \brief Makes the back slot the newest value, and gives the writer
+    //! another slot to fill.
+    //!
+    //! The new back slot holds whatever value was last put in it, which is
+    //! not necessarily the one just published.
+    inline void Publish() {
+      back_ = middle_.exchange(back_ | kUpdated) & kIndexMask;
+    }
+
+    //! \brief Returns true if a value has been published since the reader
+    //! last took one.
+    inline bool HasUpdate() const { return (middle_.load() & kUpdated) != 0; }
+
+    //! \brief Moves the newest value published into the front slot.
+    //!
+    //! Returns false, leaving the front slot alone, if nothing has been
+    //! published since the last call.
+    inline bool Update() {
+      if (!HasUpdate()) {
+        return false;
+      }
+      front_ = middle_.exchange(front_) & kIndexMask;
+      return true;
+    }
+
+    //! \brief Returns the slot holding the value the reader last took.
+    inline T* front() { return &slots_[front_]; }
+
+    //! \brief Returns the slot holding the value the reader last took.
+    inline const T* front() const { return &slots_[front_]; }
+
+  private:
+    // Copying is not allowed.
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+
+    // middle_ holds the index of the middle slot, with kUpdated set if it
+    // was published since the reader last took it.
+    static const int kIndexMask = 3;
+    static const int kUpdated = 4;
+
+    T slots_[3];
+
+    // Only the writer uses back_, and only the reader front_.
+    int back_;
+    int front_;
+    std::atomic<int> middle_;
+};
+}
+
+#endif  // SRC_TRIPLE_BUFFER_H_
@@ -91,7 +91,7 @@ template <typename T> class Vector3d {
     }
 
     //! \brief Compares the vector for equality with another vector.
-    bool operator==(const Vector3d<T> &other) {
+    bool operator==(const Vector3d<T> &other) const {
       return coordinates_[0] == other.coordinates_[0] &&
           coordinates_[1] == other.coordinates_[1] &&
           coordinates_[2] == other.coordinates_[2];
@@ -0,0 +1,333 @@
+//! \author Stephen McGruer
+
+#include "./vertex_cache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace computer_animation {
+
+namespace {
+
+// The number of sections in a vertex cache file.
+const int kNumVertexCacheSections = 2;
+
+// The largest quantized value. The smallest is minus this, so that
+// normals can be negated without overflowing.
+const float kMaxQuantized = 32767.0f;
+
+// The number of values whose differences share a width.
+const int kDeltaBlockSize = 16;
+
+// Appends the differences of a block of count quantized values from the
+// ones before them, in as few bytes as fit them all.
+void EncodeBlock(const uint16_t* values, const uint16_t* previous,
+    int count, std::vector<uint8_t> *data) {
+  int16_t differences[kDeltaBlockSize];
+  int width = 0;
+  for (int i = 0; i < count; i++) {
+    differences[i] = static_cast<int16_t>(values[i] - previous[i]);
+    if (differences[i] < -128 || differences[i] > 127) {
+      width = 2;
+    } else if (differences[i] != 0 && width == 0) {
+      width = 1;
+    }
+  }
+
+  data->push_back(static_cast<uint8_t>(width));
+  for (int i = 0; i < count && width == 1; i++) {
+    data->push_back(static_cast<uint8_t>(differences[i]));
+  }
+  if (width == 2) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(differences);
+    data->insert(data->end(), bytes, bytes + count * sizeof(int16_t));
+  }
+}
+}  // namespace
+
+VertexCache::VertexCache()
+    : num_vertices_(0),
+      num_frames_(0),
+      frames_per_second_(0),
+      key_frame_interval_(1),
+      mesh_hash_(0),
+      position_scale_(0.0f),
+      current_frame_(-1) {
+  for (int c = 0; c < 3; c++) {
+    position_offset_[c] = 0.0f;
+  }
+}
+
+void VertexCache::Build(const std::vector<float> &positions,
+    const std::vector<float> &normals, int num_vertices,
+    int frames_per_second, int key_frame_interval, uint64_t mesh_hash) {
+  int frame_size = 3 * num_vertices;
+  int num_frames = frame_size > 0 ? positions.size() / frame_size : 0;
+
+  // Centre the positions on the middle of their range over the whole
+  // animation, and scale them all alike so that the widest axis fits.
+  float position_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float position_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (size_t i = 0; i < positions.size(); i++) {
+    position_min[i % 3] = std::min(position_min[i % 3], positions[i]);
+    position_max[i % 3] = std::max(position_max[i % 3], positions[i]);
+  }
+  float range = 0.0f;
+  for (int c = 0; c < 3; c++) {
+    if (num_frames == 0) {
+      position_min[c] = 0.0f;
+      position_max[c] = 0.0f;
+    }
+    position_offset_[c] = 0.5f * (position_min[c] + position_max[c]);
+    range = std::max(range, position_max[c] - position_min[c]);
+  }
+  position_scale_ = range / (2.0f * kMaxQuantized);
+  float position_factor = position_scale_ > 0.0f ? 1.0f / position_scale_ :
+      0.0f;
+
+  // Quantize each frame, and store its differences from the frame before,
+  // or from zero for a key frame.
+  int num_values = 2 * frame_size;
+  std::vector<uint16_t> previous(num_values, 0);
+  std::vector<uint16_t> current(num_values);
+  std::vector<uint64_t> frame_offsets(num_frames + 1, 0);
+  std::vector<uint8_t> frame_data;
+  for (int frame = 0; frame < num_frames; frame++) {
+    const float* frame_positions = &positions[0] +
+        static_cast<size_t>(frame) * frame_size;
+    const float* frame_normals = &normals[0] +
+        static_cast<size_t>(frame) * frame_size;
+    for (int i = 0; i < frame_size; i++) {
+      float q = std::floor((frame_positions[i] - position_offset_[i % 3]) *
+          position_factor + 0.5f);
+      current[i] = static_cast<uint16_t>(static_cast<int16_t>(
+          std::max(-kMaxQuantized, std::min(q, kMaxQuantized))));
+      q = std::floor(frame_normals[i] * kMaxQuantized + 0.5f);
+      current[frame_size + i] = static_cast<uint16_t>(static_cast<int16_t>(
+          std::max(-kMaxQuantized, std::min(q, kMaxQuantized))));
+    }
+
+    if (frame % key_frame_interval == 0) {
+      previous.assign(num_values, 0);
+    }
+    frame_offsets[frame] = frame_data.size();
+    for (int i = 0; i < num_values; i += kDeltaBlockSize) {
+      EncodeBlock(&current[i], &previous[i],
+          std::min(kDeltaBlockSize, num_values - i), &frame_data);
+    }
+    previous.swap(current);
+  }
+  frame_offsets[num_frames] = frame_data.size();
+
+  num_vertices_ = num_vertices;
+  num_frames_ = num_frames;
+  frames_per_second_ = frames_per_second;
+  key_frame_interval_ = key_frame_interval;
+  mesh_hash_ = mesh_hash;
+  frame_offsets_.Assign(&frame_offsets);
+  frame_data_.Assign(&frame_data);
+  values_.Resize(num_values);
+  current_frame_ = -1;
+  file_.Close();
+}
+
+bool VertexCache::Load(const char *filename, uint64_t mesh_hash,
+    int num_vertices) {
+  MappedFile file;
+  if (!file.Open(filename) || file.size() < sizeof(VertexCacheHeader)) {
+    return false;
+  }
+
+  VertexCacheHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, "CAVB", 4) != 0 ||
+      header.version != kVertexCacheVersion ||
+      header.file_size != file.size() ||
+      header.mesh_hash != mesh_hash ||
+      header.num_vertices != static_cast<uint32_t>(num_vertices) ||
+      header.frames_per_second == 0 || header.key_frame_interval == 0) {
+    return false;
+  }
+
+  // Check that every section lies within the file and is aligned.
+  const uint64_t offsets[] = {header.frame_offsets_offset,
+      header.frame_data_offset};
+  const uint64_t sizes[] = {
+      (static_cast<uint64_t>(header.num_frames) + 1) * sizeof(uint64_t),
+      header.frame_data_size};
+  for (int i = 0; i < kNumVertexCacheSections; i++) {
+    if (offsets[i] % kCacheLineSize != 0 || offsets[i] > file.size() ||
+        sizes[i] > file.size() - offsets[i]) {
+      return false;
+    }
+  }
+
+  // Check that the frames lie within the frame data, in order, so that
+  // decoding can trust the offsets.
+  const char* data = file.data();
+  const uint64_t* frame_offsets =
+      reinterpret_cast<const uint64_t*>(data + header.frame_offsets_offset);
+  if (frame_offsets[0] != 0 ||
+      frame_offsets[header.num_frames] != header.frame_data_size) {
+    return false;
+  }
+  for (uint32_t frame = 0; frame < header.num_frames; frame++) {
+    if (frame_offsets[frame + 1] < frame_offsets[frame]) {
+      return false;
+    }
+  }
+
+  num_vertices_ = header.num_vertices;
+  num_frames_ = header.num_frames;
+  frames_per_second_ = header.frames_per_second;
+  key_frame_interval_ = header.key_frame_interval;
+  mesh_hash_ = header.mesh_hash;
+  for (int c = 0; c < 3; c++) {
+    position_offset_[c] = header.position_offset[c];
+  }
+  position_scale_ = header.position_scale;
+  frame_offsets_.Borrow(frame_offsets, header.num_frames + 1);
+  frame_data_.Borrow(reinterpret_cast<const uint8_t*>(
+      data + header.frame_data_offset), header.frame_data_size);
+  values_.Resize(6 * num_vertices_);
+  current_frame_ = -1;
+
+  // Keep the file mapped for as long as the arrays refer to it.
+  file_.Swap(&file);
+  return true;
+}
+
+bool VertexCache::Write(const char *filename) const {
+  VertexCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "CAVB", 4);
+  header.version = kVertexCacheVersion;
+  header.mesh_hash = mesh_hash_;
+  header.num_vertices = num_vertices_;
+  header.num_frames = num_frames_;
+  header.frames_per_second = frames_per_second_;
+  header.key_frame_interval = key_frame_interval_;
+  for (int c = 0; c < 3; c++) {
+    header.position_offset[c] = position_offset_[c];
+  }
+  header.position_scale = position_scale_;
+  header.frame_data_size = frame_data_.size();
+
+  // Lay the sections out one after another, each on a cache line boundary.
+  const void* sections[] = {frame_offsets_.data(), frame_data_.data()};
+  const size_t sizes[] = {
+      frame_offsets_.size() * sizeof(uint64_t),
+      frame_data_.size()};
+  uint64_t* offsets[] = {&header.frame_offsets_offset,
+      &header.frame_data_offset};
+
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < kNumVertexCacheSections; i++) {
+    offset = (offset + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+    *offsets[i] = offset;
+    offset += sizes[i];
+  }
+  header.file_size = offset;
+
+  // Write to a temporary file and rename it into place, so that a reader
+  // never sees a partly written cache.
+  std::string temporary_filename = std::string(filename) + ".tmp";
+  FILE *f = fopen(temporary_filename.c_str(), "wb");
+  if (f == NULL) {
+    return false;
+  }
+
+  static const char kZeroes[kCacheLineSize] = {0};
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  uint64_t written = sizeof(header);
+  for (int i = 0; i < kNumVertexCacheSections && ok; i++) {
+    ok = fwrite(kZeroes, 1, *offsets[i] - written, f) == *offsets[i] - written
+        && fwrite(sections[i], 1, sizes[i], f) == sizes[i];
+    written = *offsets[i] + sizes[i];
+  }
+
+  if (fclose(f) != 0 || !ok ||
+      rename(temporary_filename.c_str(), filename) != 0) {
+    remove(temporary_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool VertexCache::DecodeFrame(int frame) {
+  if (frame < 0 || frame >= num_frames_) {
+    return false;
+  }
+
+  // Carry on from the last frame decoded if it comes after the key frame
+  // at or before this one; otherwise start from that key frame.
+  int start = frame - frame % key_frame_interval_;
+  if (current_frame_ >= start && current_frame_ <= frame) {
+    start = current_frame_ + 1;
+  }
+  for (int f = start; f <= frame; f++) {
+    if (!ApplyFrame(f)) {
+      current_frame_ = -1;
+      return false;
+    }
+    current_frame_ = f;
+  }
+  return true;
+}
+
+bool VertexCache::DecodeFrame(int frame, float* positions, float* normals) {
+  if (!DecodeFrame(frame)) {
+    return false;
+  }
+
+  const int16_t* quantized_positions = this->positions();
+  const int16_t* quantized_normals = this->normals();
+  for (int i = 0; i < 3 * num_vertices_; i++) {
+    positions[i] = position_offset_[i % 3] +
+        quantized_positions[i] * position_scale_;
+    normals[i] = quantized_normals[i] * kNormalQuantum;
+  }
+  return true;
+}
+
+bool VertexCache::ApplyFrame(int frame) {
+  const uint8_t* data = frame_data_.data() + frame_offsets_[frame];
+  const uint8_t* end = frame_data_.data() + frame_offsets_[frame + 1];
+  uint16_t* values = values_.data();
+  int num_values = values_.size();
+  if (frame % key_frame_interval_ == 0) {
+    memset(values, 0, num_values * sizeof(uint16_t));
+  }
+
+  for (int first = 0; first < num_values; first += kDeltaBlockSize) {
+    int count = std::min(kDeltaBlockSize, num_values - first);
+    if (data == end) {
+      return false;
+    }
+    int width = *data++;
+    if (width > 2 || end - data < count * width) {
+      return false;
+    }
+
+    uint16_t* block = values + first;
+    if (width == 1) {
+      const int8_t* differences = reinterpret_cast<const int8_t*>(data);
+      for (int i = 0; i < count; i++) {
+        block[i] = static_cast<uint16_t>(block[i] + differences[i]);
+      }
+    } else if (width == 2) {
+      int16_t differences[kDeltaBlockSize];
+      memcpy(differences, data, count * sizeof(int16_t));
+      for (int i = 0; i < count; i++) {
+        block[i] = static_cast<uint16_t>(block[i] + differences[i]);
+      }
+    }
+    data += count * width;
+  }
+  return data == end;
+}
+}
@@ -0,0 +1,187 @@
+//! \author Stephen McGruer
+
+#ifndef SRC_VERTEX_CACHE_H_
+#define SRC_VERTEX_CACHE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "./aligned_array.h"
+#include "./mapped_file.h"
+#include "./mesh_array.h"
+
+namespace computer_animation {
+
+//! \brief The size of one step of a quantized normal.
+const float kNormalQuantum = 1.0f / 32767.0f;
+
+//! \struct VertexCacheHeader
+//! \brief The header at the start of a vertex cache file.
+//!
+//! A vertex cache holds an animation already skinned, as the position and
+//! normal of every vertex at every frame, quantized to signed 16-bit
+//! values in the layout that MeshRenderer::DrawQuantized() draws: the
+//! (x, y, z) of every vertex's position, then of every vertex's normal.
+//! Position coordinate c of a value q is position_offset[c] + q *
+//! position_scale, where the scale is the same on every axis and covers
+//! the whole animation. A normal's coordinates are q * kNormalQuantum.
+//!
+//! A frame is stored as the difference of each quantized value from the
+//! same value in the frame before, wrapping around at 16 bits. The values
+//! are split into blocks of 16 (the last block may be shorter). Each block
+//! is a byte giving the width of its differences, then the differences:
+//! none if the width is 0 (nothing moved), signed bytes if 1 and signed
+//! 16-bit values if 2. Every key_frame_interval-th frame, starting with the
+//! first, is a key frame, stored as differences from zero, so playback can
+//! start there.
+//!
+//! The sections follow the header, each on a cache line boundary:
+//!   frame offsets  num_frames + 1 uint64_t byte offsets of the frames
+//!                  from the start of the frame data.
+//!   frame data     The encoded frames, one after another.
+//! All values are stored in the machine's native byte order.
+struct VertexCacheHeader {
+  char magic[4];  // Always "CAVB".
+  uint32_t version;
+
+  // The size of the whole file, in bytes.
+  uint64_t file_size;
+
+  // The hash of the files the mesh was loaded from; see HashMeshSources.
+  uint64_t mesh_hash;
+
+  uint32_t num_vertices;
+  uint32_t num_frames;
+  uint32_t frames_per_second;
+  uint32_t key_frame_interval;
+
+  float position_offset[3];
+  float position_scale;
+
+  // Byte offsets of the sections from the start of the file.
+  uint64_t frame_offsets_offset;
+  uint64_t frame_data_offset;
+  uint64_t frame_data_size;
+};
+
+//! \brief The current vertex cache version.
+const uint32_t kVertexCacheVersion = 1;
+
+//! \brief The default number of frames from one key frame to the next.
+const int kDefaultKeyFrameInterval = 25;
+
+//! \class VertexCache
+//! \brief A baked animation of a mesh, which can be played back without
+//! posing a skeleton or skinning.
+//!
+//! The decoder keeps the last frame it decoded, so playing forwards
+//! decodes one frame's differences per frame. Jumping backwards, or past
+//! a key frame, starts again from the nearest key frame before the frame
+//! wanted. Decoded frames are left quantized, so they can be handed to the
+//! renderer as they are.
+class VertexCache {
+  public:
+    VertexCache();
+
+    //! \brief Builds the cache from skinned frames.
+    //!
+    //! positions and normals each hold num_frames frames one after
+    //! another, each of which is an (x, y, z) triple per vertex. mesh_hash
+    //! identifies the mesh the frames were skinned from (see
+    //! HashMeshSources()), and is checked when the cache is loaded.
+    void Build(const std::vector<float> &positions,
+        const std::vector<float> &normals, int num_vertices,
+        int frames_per_second, int key_frame_interval, uint64_t mesh_hash);
+
+    //! \brief Maps a vertex cache file and uses it in place.
+    //!
+    //! Returns false if the file cannot be read or is not a valid vertex
+    //! cache for a mesh with the given hash and number of vertices.
+    bool Load(const char *filename, uint64_t mesh_hash, int num_vertices);
+
+    //! \brief Writes the cache to a file. Returns false on failure.
+    bool Write(const char *filename) const;
+
+    //! \brief Decodes a frame into positions() and normals().
+    //!
+    //! Returns false, leaving them in an unspecified state, if the frame's
+    //! data is corrupt.
+    bool DecodeFrame(int frame);
+
+    //! \brief Decodes a frame and converts it into (x, y, z) triples of
+    //! floating point positions and normals, one per vertex.
+    bool DecodeFrame(int frame, float* positions, float* normals);
+
+    //! \brief Returns the quantized positions of the last frame decoded,
+    //! as (x, y, z) triples.
+    inline const int16_t* positions() const {
+      return reinterpret_cast<const int16_t*>(values_.data());
+    }
+
+    //! \brief Returns the quantized normals of the last frame decoded, as
+    //! (x, y, z) triples.
+    inline const int16_t* normals() const {
+      return positions() + 3 * num_vertices_;
+    }
+
+    //! \brief Returns the position that a quantized position of (0, 0, 0)
+    //! stands for.
+    inline const float* position_offset() const { return position_offset_; }
+
+    //! \brief Returns the size of one step of a quantized position.
+    inline float position_scale() const { return position_scale_; }
+
+    //! \brief Returns the number of vertices in each frame.
+    inline int num_vertices() const { return num_vertices_; }
+
+    //! \brief Returns the number of frames.
+    inline int num_frames() const { return num_frames_; }
+
+    //! \brief Returns the rate the frames were baked at.
+    inline int frames_per_second() const { return frames_per_second_; }
+
+    //! \brief Returns the length of the animation in seconds.
+    inline float duration() const {
+      return num_frames_ > 0 ?
+          static_cast<float>(num_frames_ - 1) / frames_per_second_ : 0.0f;
+    }
+
+    //! \brief Returns the size of the encoded frames, in bytes.
+    inline size_t SizeInBytes() const { return frame_data_.size(); }
+
+    //! \brief Returns true if the cache has no frames, i.e. none has been
+    //! built or loaded.
+    inline bool empty() const { return num_frames_ == 0; }
+
+  private:
+    // Copying is not allowed.
+    VertexCache(const VertexCache&);
+    VertexCache& operator=(const VertexCache&);
+
+    // Applies a frame's differences to values_. Returns false if the
+    // frame's data is corrupt.
+    bool ApplyFrame(int frame);
+
+    int num_vertices_;
+    int num_frames_;
+    int frames_per_second_;
+    int key_frame_interval_;
+    uint64_t mesh_hash_;
+    float position_offset_[3];
+    float position_scale_;
+
+    MeshArray<uint64_t> frame_offsets_;
+    MeshArray<uint8_t> frame_data_;
+
+    // The quantized values of the last frame decoded, and its number, or
+    // -1 if none. The arithmetic is unsigned so that it wraps around.
+    AlignedArray<uint16_t> values_;
+    int current_frame_;
+
+    // The cache file, when the cache was loaded from one.
+    MappedFile file_;
+};
+}
+
+#endif  // SRC_VERTEX_CACHE_H_
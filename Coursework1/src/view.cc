@@ -2,19 +2,39 @@
 
 #include <GL/glut.h>
 
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <map>
 #include <set>
+#include <string>
 
 #include "./animation_controller.h"
 #include "./cav_utils.h"
-#include "./matrix.h"
+#include "./fixed_matrix-inl.h"
+#include "./frame_pipeline.h"
+#include "./ik_solver.h"
+#include "./lod_chain.h"
+#include "./mesh_cache.h"
+#include "./mesh_renderer.h"
+#include "./skinning_engine.h"
 #include "./triangle_mesh.h"
+#include "./vertex_cache.h"
 
 namespace ca = computer_animation;
 
 const int kWindowWidth = 480;
 const int kWindowHeight = 480;
 
+// The camera's vertical field of view in degrees, and its distance from
+// the origin.
+const double kFieldOfView = 40.0;
+const double kEyeDistance = 7.0;
+
+// How far in pixels the automatically chosen level of detail may stray from
+// the full mesh.
+const float kMaxLodPixelError = 1.0f;
+
 // The lighting position and parameters. Position is (x, y, z, W),
 // parameters are (R, G, B, A).
 const GLfloat kLightPosition[] = {0.0, 0.0, 1.0, 0.0};
@@ -22,9 +42,23 @@ const GLfloat kAmbientLight[]  = {0.5, 0.5, 0.5, 1.0};
 const GLfloat kDiffuseLight[]  = {0.8, 0.8, 0.8, 1.0};
 const GLfloat kSpecularLight[] = {0.8, 0.8, 0.8, 1.0};
 
-// Stores the model polygon.
+// Stores the model polygon, the engine that skins it and the renderer
+// that draws it.
 ca::TriangleMesh the_model;
-std::vector<ca::Vector3d<float> > skin_vertices;
+ca::SkinningEngine skinning_engine;
+ca::MeshRenderer mesh_renderer;
+
+// The levels of detail of the model, and the one being drawn. With
+// lod_auto, the level is chosen every frame from how large the model is on
+// screen.
+ca::LodChain lod_chain;
+int lod_budget = 0;
+bool lod_auto = false;
+int current_lod = 0;
+
+// If positive, the number of animation frames to draw as fast as possible
+// before exiting, to time the rendering.
+int benchmark_frames = 0;
 
 // The current location and rotation of the model, using world
 // co-ordinates.
@@ -68,24 +102,160 @@ char current_axis = 'x';
 
 // Animation-related trackers.
 ca::AnimationController animation_controller;
+const char* animation_file = "animations/all";
+const char* skeleton_file = "skeleton2.out";
 bool animation_running = false;
+int animation_start_time = 0;  // In milliseconds since glutInit.
+float animation_time = 0.0f;  // In seconds since the animation started.
+
+// Inverse kinematics. ']' and '}' move the feet and hands of the default
+// skeleton (ca::kLimbEndBones) from their rest positions by the given
+// offsets: the right foot stays put, the left foot steps up and forwards
+// and the hands reach in and up.
+ca::IkSolver ik_solver;
+const float kIkOffsets[ca::kNumLimbEndBones][3] = {
+  {0.0f, 0.0f, 0.0f},
+  {0.0f, 0.3f, 0.3f},
+  {-0.3f, 0.3f, 0.2f},
+  {0.3f, 0.2f, 0.2f}
+};
+
+// A baked animation, played in a loop in place of posing and skinning the
+// model, when -vertex-cache is given.
+ca::VertexCache vertex_cache;
+const char* vertex_cache_file = NULL;
+int vertex_cache_frame = 0;  // The last frame decoded successfully.
+
+// Poses and skins each frame on a worker thread while the one before is
+// drawn, unless -serial is given. It uses skinning_engine and
+// animation_controller while it runs, so is declared after them and is
+// stopped before they are destroyed.
+ca::FramePipeline frame_pipeline;
+bool serial_frames = false;
 
 // Forward declarations.
 void DisplayCallback();
-void TimerCallback(int frame);
+void TimerCallback(int value);
 void MouseClickCallback(int button, int state, int x, int y);
 void MouseDragCallback(int x, int y);
 void KeyPressedCallback(unsigned char key, int x, int y);
 void RecalculateModelView(void);
+void UseLod(int level);
+void SelectLodByScreenSize();
+bool VerifySkinning();
+bool VerifyNormals();
+bool VerifyInstances();
+void BenchmarkCallback();
 
 int main(int argc, char **argv) {
   if (argc < 3)  {
-    fprintf(stderr, "Usage: %s <object> <weight>\n", argv[0]);
+    fprintf(stderr, "Usage: %s <object> <weight> [-threads n] [-verify] "
+        "[-nocache] [-optimize] [-benchmark frames] [-lod-budget vertices] "
+        "[-lod-auto] [-animation file] [-skeleton file] "
+        "[-vertex-cache file] [-serial]\n", argv[0]);
     exit(1);
   }
-  the_model.LoadFile(argv[1]);
-  the_model.LoadWeights(argv[2]);
-  skin_vertices.resize(the_model.GetNumberOfVertices());
+
+  bool verify = false;
+  bool use_cache = true;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-verify") == 0) {
+      verify = true;
+    } else if (strcmp(argv[i], "-nocache") == 0) {
+      use_cache = false;
+    } else if (strcmp(argv[i], "-optimize") == 0) {
+      the_model.SetOptimizeVertexOrder(true);
+    } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      skinning_engine.SetNumThreads(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-benchmark") == 0 && i + 1 < argc) {
+      benchmark_frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-lod-budget") == 0 && i + 1 < argc) {
+      lod_budget = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-lod-auto") == 0) {
+      lod_auto = true;
+    } else if (strcmp(argv[i], "-animation") == 0 && i + 1 < argc) {
+      animation_file = argv[++i];
+    } else if (strcmp(argv[i], "-skeleton") == 0 && i + 1 < argc) {
+      skeleton_file = argv[++i];
+    } else if (strcmp(argv[i], "-vertex-cache") == 0 && i + 1 < argc) {
+      vertex_cache_file = argv[++i];
+    } else if (strcmp(argv[i], "-serial") == 0) {
+      serial_frames = true;
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  if (use_cache) {
+    std::string cache_file = std::string(argv[1]) + ".cache";
+    the_model.LoadWithCache(argv[1], argv[2], cache_file.c_str());
+  } else {
+    the_model.LoadFile(argv[1]);
+    the_model.LoadWeights(argv[2]);
+    if (the_model.optimize_vertex_order()) {
+      float acmr_before;
+      float acmr_after;
+      the_model.OptimizeVertexOrder(&acmr_before, &acmr_after);
+      fprintf(stdout, "ACMR: %.3f before optimizing, %.3f after\n",
+          acmr_before, acmr_after);
+    }
+  }
+
+  if (!the_model.LoadSkeleton(skeleton_file)) {
+    exit(1);
+  }
+  const ca::Skeleton skeleton = *the_model.skeleton();
+  animation_controller.SetSkeleton(skeleton);
+  ik_solver.Init(skeleton);
+  for (int i = 0; i < ca::kNumLimbEndBones; i++) {
+    if (ik_solver.AddEffector(ca::kLimbEndBones[i], 0) < 0) {
+      // The skeleton is not the default one, so the demo is left out.
+      ik_solver.Init(skeleton);
+      break;
+    }
+  }
+
+  skinning_engine.Init(the_model);
+  skinning_engine.SetNormalsEnabled(true);
+
+  if (vertex_cache_file != NULL) {
+    // The cache holds the full mesh, so levels of detail cannot be used.
+    uint64_t mesh_hash;
+    if (lod_budget > 0 || lod_auto) {
+      fprintf(stderr, "Error: -vertex-cache cannot be used with levels of "
+          "detail\n");
+      exit(1);
+    }
+    if (!ca::HashMeshSources(argv[1], argv[2], the_model.max_influences(),
+            the_model.optimize_vertex_order(), &mesh_hash) ||
+        !vertex_cache.Load(vertex_cache_file, mesh_hash,
+            the_model.GetNumberOfVertices()) ||
+        vertex_cache.empty() || !vertex_cache.DecodeFrame(0)) {
+      fprintf(stderr, "Error: %s is not a vertex cache baked from %s and %s "
+          "(see cav_batch bake)\n", vertex_cache_file, argv[1], argv[2]);
+      exit(1);
+    }
+  }
+
+  if (verify) {
+    // Check the skinning kernels against the reference skinning, without
+    // opening a window.
+    animation_controller.LoadAnimation(animation_file);
+    return VerifySkinning() ? 0 : 1;
+  }
+
+  // The levels of detail share the_model's skeleton, so the controls and
+  // animations still pose the_model.
+  lod_chain.Build(the_model,
+      (lod_budget > 0 || lod_auto) ? ca::kDefaultLodLevels : 1,
+      ca::kDefaultLodReduction);
+  if (lod_budget > 0) {
+    current_lod = lod_chain.SelectByVertexBudget(lod_budget);
+    skinning_engine.Init(lod_chain.level(current_lod));
+    fprintf(stdout, "Using level of detail %d: %d vertices\n", current_lod,
+        lod_chain.level(current_lod).GetNumberOfVertices());
+  }
 
   glutInit(&argc, argv);
 
@@ -110,26 +280,40 @@ int main(int argc, char **argv) {
 
   // Setup the perspective projection parameters.
   glMatrixMode(GL_PROJECTION);
-  gluPerspective(40.0,    // Field of view. (Degrees.)
-      1.0,      // Aspect ratio.
-      1.0,      // Z near.
-      1000.0);  // Z far.
+  gluPerspective(kFieldOfView,  // Field of view. (Degrees.)
+      1.0,                      // Aspect ratio.
+      1.0,                      // Z near.
+      1000.0);                  // Z far.
 
   // Setup the normal view parameters.
   glMatrixMode(GL_MODELVIEW);
-  gluLookAt(0.0, 0.0, 7.0,  // The viewing eye is at (0,0,7).
-      0.0, 0.0, 0.0,        // The centre is at (0,0,0).
-      0.0, 1.0, 0.0);       // The 'up' vector is in positive Y direction.
+  gluLookAt(0.0, 0.0, kEyeDistance,  // The viewing eye is at (0,0,7).
+      0.0, 0.0, 0.0,                 // The centre is at (0,0,0).
+      0.0, 1.0, 0.0);  // The 'up' vector is in positive Y direction.
 
   // Push the base view parameters down one, so we can later push the
   // recalculations on top of that.
   glPushMatrix();
 
-  // Display callback function.
-  glutDisplayFunc(DisplayCallback);
+  mesh_renderer.Init(lod_chain.level(current_lod));
 
+  // Display callback function.
+  if (benchmark_frames > 0) {
+    glutDisplayFunc(BenchmarkCallback);
+  } else {
+    glutDisplayFunc(DisplayCallback);
+  }
 
-  animation_controller.LoadAnimation("animations/all");
+  animation_controller.LoadAnimation(animation_file);
+  if (vertex_cache.empty() && !serial_frames) {
+    frame_pipeline.Start(&skinning_engine, &animation_controller, skeleton);
+  }
+  if (!vertex_cache.empty() && benchmark_frames == 0) {
+    // Play the baked animation in a loop from the start.
+    animation_running = true;
+    animation_start_time = glutGet(GLUT_ELAPSED_TIME);
+    glutTimerFunc(0, TimerCallback, 0);
+  }
 
   glutMouseFunc(MouseClickCallback);
   glutMotionFunc(MouseDragCallback);
@@ -147,105 +331,126 @@ void DisplayCallback() {
     RecalculateModelView();
   }
 
+  if (lod_auto) {
+    SelectLodByScreenSize();
+  }
+
   // Clear the window.
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  int number_of_triangles = the_model.GetNumberOfTriangles();
-
-  ca::Skeleton skeleton = *the_model.skeleton();
-  int num_bones = skeleton.GetNumberBones();
-  int number_of_vertices = the_model.GetNumberOfVertices();
-
-  std::vector<ca::Matrix<float> > ms;
-  for (int i = 0; i < num_bones; i++) {
-    ca::Bone bone = skeleton.GetBone(i);
-    ca::Matrix<float> m(4, 4);
-    bone.CalculateM(&m);
-    ms.push_back(m);
+  if (!vertex_cache.empty()) {
+    mesh_renderer.DrawQuantized(vertex_cache.positions(),
+        vertex_cache.normals(), vertex_cache.position_offset(),
+        vertex_cache.position_scale());
+  } else if (frame_pipeline.running()) {
+    // Ask for this frame, and draw the newest one the worker has finished
+    // (usually the last one asked for) while it skins this one. Edits made
+    // with the keyboard are waited for, so they show at once; so is the
+    // first frame of a new level of detail.
+    const ca::TriangleMesh &mesh = lod_chain.level(current_lod);
+    if (animation_running) {
+      frame_pipeline.RequestAnimation(mesh, animation_time);
+    } else {
+      frame_pipeline.RequestPose(mesh, *the_model.skeleton());
+    }
+    const ca::SkinnedFrame* frame = frame_pipeline.LatestFrame();
+    if (!animation_running || frame == NULL || frame->mesh != &mesh) {
+      frame = frame_pipeline.WaitForFrame();
+    }
+    mesh_renderer.Draw(frame->positions.data(), frame->normals.data());
+  } else {
+    skinning_engine.Skin(the_model.skeleton());
+    mesh_renderer.Draw(skinning_engine.positions(),
+        skinning_engine.normals());
   }
 
-  // Do the linear blending.
-  for (int i = 0; i < number_of_vertices; i++) {
-    ca::Vector3d<float> v_hat = the_model.GetVertex(i);
-    ca::Vector3d<float> v(0, 0, 0);
-
-    for (int b = 0; b < num_bones; b++) {
-      ca::Bone bone = skeleton.GetBone(b);
-      float weight = the_model.GetBoneWeight(b, i);
-
-      // M_hat^-1
-      ca::Vector3d<float> tmp = v_hat - bone.RestPosition();
-
-      // M
-      ca::Matrix<float> m = ms[b];
-      ca::Matrix<float> vertex_matrix(4, 1);
-      vertex_matrix(0, 0) = tmp[0];
-      vertex_matrix(0, 1) = tmp[1];
-      vertex_matrix(0, 2) = tmp[2];
-      vertex_matrix(0, 3) = 1.0f;
-
-      ca::Matrix<float> result = m * vertex_matrix;
-
-      tmp[0] = (result(0, 0) / result(0, 3));
-      tmp[1] = (result(0, 1) / result(0, 3));
-      tmp[2] = (result(0, 2) / result(0, 3));
-
-      // W_i
-      tmp *= weight;
-
-      v += tmp;
-    }
+  glutSwapBuffers();
+}
 
-    skin_vertices[i] = v;
+//! \brief Draws benchmark_frames frames of the animation as fast as
+//! possible, reports the time taken and exits.
+void BenchmarkCallback() {
+  int num_frames = vertex_cache.empty() ?
+      animation_controller.NumberFrames() : vertex_cache.num_frames();
+  if (num_frames == 0) {
+    fprintf(stderr, "Error: No animation to benchmark\n");
+    exit(1);
   }
 
-  // Temporary variables for vertices and normals.
-  ca::Vector3d<float> v1;
-  ca::Vector3d<float> v2;
-  ca::Vector3d<float> v3;
-  int v1_i;
-  int v2_i;
-  int v3_i;
-  ca::Vector3d<float> n1;
-  ca::Vector3d<float> n2;
-  ca::Vector3d<float> n3;
-
-  for (int i = 0; i < number_of_triangles; i++) {
-    ca::Triangle triangle = the_model.GetTriangle(i);
-    triangle.GetVertexIndices(&v1_i, &v2_i, &v3_i);
-    the_model.GetTriangleNormals(i, &n1, &n2, &n3);
-    v1 = skin_vertices[v1_i];
-    v2 = skin_vertices[v2_i];
-    v3 = skin_vertices[v3_i];
-
-    GLfloat skinColor[] = {0.8, 0.1, 0.1, 1.0};
-
-    glBegin(GL_TRIANGLES);
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, skinColor);
-    glNormal3f(-n1[0], -n1[1], -n1[2]);
-    glVertex3f(v1[0], v1[1], v1[2]);
-
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, skinColor);
-    glNormal3f(-n2[0], -n2[1], -n2[2]);
-    glVertex3f(v2[0], v2[1], v2[2]);
-
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, skinColor);
-    glNormal3f(-n3[0], -n3[1], -n3[2]);
-    glVertex3f(v3[0], v3[1], v3[2]);
-    glEnd();
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (int frame = 0; frame < benchmark_frames; frame++) {
+    if (frame_pipeline.running()) {
+      // Wait for the frame asked for last time round, so that every frame
+      // drawn is a new one, while the worker skins this one.
+      frame_pipeline.WaitForFrame();
+      animation_running = true;
+      animation_time = static_cast<float>(frame % num_frames) / ca::kFps;
+    } else if (vertex_cache.empty()) {
+      the_model.SetSkeleton(animation_controller.Frame(frame % num_frames));
+    } else if (!vertex_cache.DecodeFrame(frame % num_frames)) {
+      fprintf(stderr, "Error: Frame %d of vertex cache %s is corrupt\n",
+          frame % num_frames, vertex_cache_file);
+      exit(1);
+    }
+    DisplayCallback();
   }
-
-  glutSwapBuffers();
+  glFinish();
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  fprintf(stdout, "Drew %d frames in %.3f s (%.2f ms/frame) using %s on "
+      "%s\n", benchmark_frames, seconds, 1000.0 * seconds / benchmark_frames,
+      mesh_renderer.uses_buffer_objects() ? "buffer objects" :
+      "client arrays", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+  exit(0);
 }
 
 //! \brief A timer callback used to run animations.
-void TimerCallback(int frame) {
-  if (frame >= animation_controller.NumberFrames() || frame < 0) {
+//!
+//! The model is posed for the time since the animation started, rather
+//! than stepped a frame at a time, so the animation plays at the right
+//! speed however fast the frames are drawn.
+void TimerCallback(int value) {
+  int elapsed_ms = glutGet(GLUT_ELAPSED_TIME) - animation_start_time;
+  if (!vertex_cache.empty()) {
+    // Baked animations loop for as long as the viewer runs.
+    int frame = static_cast<int>(static_cast<int64_t>(elapsed_ms) *
+        vertex_cache.frames_per_second() / 1000 % vertex_cache.num_frames());
+    if (!vertex_cache.DecodeFrame(frame)) {
+      // Stop playback on the last frame that decoded, rather than drawing
+      // whatever the corrupt one left behind.
+      fprintf(stderr, "Error: Frame %d of vertex cache %s is corrupt; "
+          "stopping playback\n", frame, vertex_cache_file);
+      vertex_cache.DecodeFrame(vertex_cache_frame);
+      glutPostRedisplay();
+      return;
+    }
+    vertex_cache_frame = frame;
+    glutPostRedisplay();
+    glutTimerFunc(ca::kMillisecondsPerFrame, TimerCallback, 0);
+    return;
+  }
+
+  float t = elapsed_ms / 1000.0f;
+  if (t > animation_controller.duration()) {
+    t = animation_controller.duration();
     animation_running = false;
+  }
+  if (!frame_pipeline.running()) {
+    animation_controller.Sample(t, the_model.skeleton());
+  } else if (animation_running) {
+    // The worker samples the animation as it skins each frame.
+    animation_time = t;
   } else {
-    the_model.SetSkeleton(animation_controller.Frame(frame));
-    glutPostRedisplay();
-    glutTimerFunc(ca::kMillisecondsPerFrame, TimerCallback, frame + 1);
+    // Carry on from the last pose of the animation once it has finished,
+    // taking it from the worker, which owns the controller.
+    frame_pipeline.RequestAnimation(lod_chain.level(current_lod), t);
+    the_model.SetSkeleton(frame_pipeline.WaitForFrame()->pose);
+  }
+  glutPostRedisplay();
+  if (animation_running) {
+    glutTimerFunc(ca::kMillisecondsPerFrame, TimerCallback, 0);
   }
 }
 
@@ -271,8 +476,8 @@ void MouseDragCallback(int x, int y) {
 
 //! \brief Called when the user pressed a key.
 //!
-//! Handles running animations, CCD, manually altering the model,
-//! resetting the model, and printing out the skeleton state.
+//! Handles running animations, inverse kinematics, manually altering the
+//! model, resetting the model, and printing out the skeleton state.
 void KeyPressedCallback(unsigned char key, int x, int y) {
   if (animation_running) {
     return;
@@ -281,20 +486,34 @@ void KeyPressedCallback(unsigned char key, int x, int y) {
   if (key == '[') {
     // Start animation.
     animation_running = true;
+    animation_start_time = glutGet(GLUT_ELAPSED_TIME);
     glutTimerFunc(0, TimerCallback, 0);
-  } else if (key == ']') {
-    // Attempt CCD.
-    ca::Skeleton skeleton;
-    ca::Vector3d<float> new_pos(1.3, -1.9, -0.622992);
+  } else if ((key == ']' || key == '}') && ik_solver.num_effectors() == 0) {
+    fprintf(stdout, "The skeleton does not have the bones used for inverse "
+        "kinematics.\n");
+  } else if (key == ']' || key == '}') {
+    // Pose the limbs with inverse kinematics, using CCD for ']' and FABRIK
+    // for '}', starting from the rest pose.
+    ca::Skeleton skeleton = *the_model.skeleton();
+    skeleton.Reset();
+    skeleton.UpdateTransforms();
+    for (int i = 0; i < ik_solver.num_effectors(); i++) {
+      int bone = ik_solver.effector_bone(i);
+      ik_solver.SetTarget(i, ca::IkSolver::JointPosition(skeleton, bone) +
+          ca::Vector3d<float>(kIkOffsets[i][0], kIkOffsets[i][1],
+              kIkOffsets[i][2]));
+    }
+    ik_solver.SetMethod(key == ']' ? ca::kCcdMethod : ca::kFabrikMethod);
 
-    skeleton.CCDMoveBoneTo(21, new_pos);
+    ca::IkResult result = ik_solver.Solve(&skeleton);
+    fprintf(stdout, "%s: %d iterations, %.1f us, largest error %.4f%s\n",
+        key == ']' ? "CCD" : "FABRIK", result.iterations,
+        result.seconds * 1e6, result.error,
+        result.converged ? "" : " (did not converge)");
     the_model.SetSkeleton(skeleton);
   } else if (keyboard_map.find(key) != keyboard_map.end()) {
     // Select a bone.
     current_bone = keyboard_map[key];
-    ca::Bone bone = the_model.skeleton()->GetBone(current_bone);
-
-    const ca::Vector3d<float> pos = bone.CurrentPosition();
     fprintf(stdout, "You have selected joint %d\n", current_bone);
   } else if (key == 'x' || key == 'y' || key == 'z') {
     // Select an axis.
@@ -322,6 +541,13 @@ void KeyPressedCallback(unsigned char key, int x, int y) {
     }
     the_model.skeleton()->AdjustBoneRotation(current_bone,
         rotation_delta);
+  } else if (key == ',' || key == '.') {
+    // Move the model away from or towards the camera.
+    zloc += (key == '.') ? 0.5 : -0.5;
+    if (zloc > kEyeDistance - 2.0) {
+      zloc = kEyeDistance - 2.0;
+    }
+    refresh_model = true;
   } else if (key == '#') {
     // Reset.
     the_model.skeleton()->Reset();
@@ -329,9 +555,10 @@ void KeyPressedCallback(unsigned char key, int x, int y) {
     // Print out the current keyframe.
     fprintf(stdout, "Current keyframe:\n");
 
-    ca::Skeleton skeleton = *the_model.skeleton();
-    for (int i = 0; i < skeleton.GetNumberBones(); i++) {
-      ca::Vector3d<int> rotation = skeleton.GetBone(i).Rotation();
+    ca::ArrayView<ca::Vector3d<int> > rotations =
+        the_model.skeleton()->rotations();
+    for (unsigned int i = 0; i < rotations.size(); i++) {
+      const ca::Vector3d<int> &rotation = rotations[i];
       if (rotation[0] != 0 || rotation[1] != 0 || rotation[2] != 0) {
         fprintf(stdout, "%d %d %d %d\n", i, rotation[0], rotation[1],
             rotation[2]);
@@ -356,3 +583,173 @@ void RecalculateModelView(void) {
 
   refresh_model = false;
 }
+
+//! \brief Switches to drawing the given level of detail.
+void UseLod(int level) {
+  if (level == current_lod) {
+    return;
+  }
+  current_lod = level;
+  if (!frame_pipeline.running()) {
+    // Otherwise the worker sets up the engine when it is asked for a frame
+    // of the new level.
+    skinning_engine.Init(lod_chain.level(level));
+    skinning_engine.SetNormalsEnabled(true);
+  }
+  mesh_renderer.Init(lod_chain.level(level));
+  fprintf(stdout, "Using level of detail %d: %d vertices\n", level,
+      lod_chain.level(level).GetNumberOfVertices());
+}
+
+//! \brief Picks the least detailed level whose error would be under
+//! kMaxLodPixelError pixels at the model's current distance.
+void SelectLodByScreenSize() {
+  double distance = kEyeDistance - zloc;
+  double visible_height =
+      2.0 * distance * std::tan(kFieldOfView * M_PI / 360.0);
+  float pixel_size = lod_chain.size() *
+      glutGet(GLUT_WINDOW_HEIGHT) / visible_height;
+  UseLod(lod_chain.SelectByScreenSize(pixel_size, kMaxLodPixelError));
+}
+
+//! \brief Checks every skinning kernel against the reference skinning.
+//!
+//! Each frame of the loaded animation is skinned with SkinReference and
+//! with every kernel that the CPU supports. Returns true if all of the
+//! kernels match the reference.
+bool VerifySkinning() {
+  const float kTolerance = 1e-5f;
+  const ca::SkinningKernel kernels[] = {
+      ca::kScalarKernel, ca::kSseKernel, ca::kAvx2Kernel};
+
+  std::vector<ca::Vector3d<float> > expected;
+  bool success = true;
+  for (int k = 0; k < 3; k++) {
+    if (!skinning_engine.SetKernel(kernels[k])) {
+      fprintf(stdout, "%s: not supported by this CPU\n",
+          ca::KernelName(kernels[k]));
+      continue;
+    }
+
+    float max_error = 0.0f;
+    for (int frame = 0; frame < animation_controller.NumberFrames();
+         frame++) {
+      the_model.SetSkeleton(animation_controller.Frame(frame));
+      ca::SkinReference(&the_model, &expected);
+      skinning_engine.Skin(the_model.skeleton());
+
+      ca::ArrayView<ca::Vector3d<float> > positions =
+          skinning_engine.skinned_positions();
+      for (unsigned int i = 0; i < positions.size(); i++) {
+        const ca::Vector3d<float> &actual = positions[i];
+        for (int c = 0; c < 3; c++) {
+          float error = std::fabs(actual[c] - expected[i][c]);
+          max_error = (error > max_error) ? error : max_error;
+        }
+      }
+    }
+
+    bool passed = max_error <= kTolerance;
+    fprintf(stdout, "%s: max error %g over %d frames: %s\n",
+        ca::KernelName(kernels[k]), max_error,
+        animation_controller.NumberFrames(), passed ? "OK" : "FAILED");
+    success = success && passed;
+  }
+
+  bool normals_passed = VerifyNormals();
+  bool instances_passed = VerifyInstances();
+  return normals_passed && instances_passed && success;
+}
+
+//! \brief Checks the skinned normals against normals computed from scratch.
+//!
+//! Runs through the animation and then bends each bone in turn, so that
+//! both full and partial updates of the normals are checked.
+bool VerifyNormals() {
+  const float kTolerance = 1e-5f;
+
+  skinning_engine.SetKernel(ca::BestSupportedKernel());
+  skinning_engine.SetNormalsEnabled(true);
+
+  int num_frames = animation_controller.NumberFrames();
+  int num_bones = the_model.skeleton()->GetNumberBones();
+  float max_error = 0.0f;
+  for (int step = 0; step < num_frames + num_bones; step++) {
+    if (step < num_frames) {
+      the_model.SetSkeleton(animation_controller.Frame(step));
+    } else {
+      the_model.skeleton()->AdjustBoneRotation(step - num_frames,
+          ca::Vector3d<int>(10, 20, 30));
+    }
+    skinning_engine.Skin(the_model.skeleton());
+
+    ca::ArrayView<ca::Vector3d<float> > positions =
+        skinning_engine.skinned_positions();
+    ca::ArrayView<ca::Vector3d<float> > normals =
+        skinning_engine.skinned_normals();
+    ca::ArrayView<ca::Triangle> triangles = the_model.triangles();
+    for (int i = 0; i < the_model.GetNumberOfVertices(); i++) {
+      ca::ArrayView<int> faces = the_model.vertex_faces(i);
+      ca::Vector3d<float> expected(0.0f, 0.0f, 0.0f);
+      for (unsigned int j = 0; j < faces.size(); j++) {
+        const int* corners = triangles[faces[j]].vertex_indices();
+        const ca::Vector3d<float> &v1 = positions[corners[0]];
+        ca::Vector3d<float> face_normal = ca::CrossProduct(
+            positions[corners[2]] - v1, positions[corners[1]] - v1);
+        face_normal.Normalize();
+        expected += face_normal;
+      }
+      if (!faces.empty()) {
+        expected /= static_cast<float>(faces.size());
+      } else {
+        expected = ca::Vector3d<float>(0.0f, 0.0f, 1.0f);
+      }
+
+      const ca::Vector3d<float> &actual = normals[i];
+      for (int c = 0; c < 3; c++) {
+        float error = std::fabs(actual[c] - expected[c]);
+        max_error = (error > max_error) ? error : max_error;
+      }
+    }
+  }
+
+  bool passed = max_error <= kTolerance;
+  fprintf(stdout, "normals: max error %g over %d poses: %s\n", max_error,
+      num_frames + num_bones, passed ? "OK" : "FAILED");
+  return passed;
+}
+
+//! \brief Checks skinning a crowd of instances against the reference
+//! skinning, with one instance posed at each frame of the animation.
+bool VerifyInstances() {
+  const float kTolerance = 1e-5f;
+
+  int num_frames = animation_controller.NumberFrames();
+  std::vector<ca::Skeleton> skeletons(num_frames, *the_model.skeleton());
+  std::vector<ca::Skeleton*> instances(num_frames);
+  for (int frame = 0; frame < num_frames; frame++) {
+    skeletons[frame] = animation_controller.Frame(frame);
+    instances[frame] = &skeletons[frame];
+  }
+  skinning_engine.SkinInstances(instances.data(), num_frames);
+
+  std::vector<ca::Vector3d<float> > expected;
+  float max_error = 0.0f;
+  for (int frame = 0; frame < num_frames; frame++) {
+    the_model.SetSkeleton(skeletons[frame]);
+    ca::SkinReference(&the_model, &expected);
+
+    const float* positions = skinning_engine.instance_positions(frame);
+    for (unsigned int i = 0; i < expected.size(); i++) {
+      for (int c = 0; c < 3; c++) {
+        float error = std::fabs(positions[3 * i + c] - expected[i][c]);
+        max_error = (error > max_error) ? error : max_error;
+      }
+    }
+  }
+
+  bool passed = max_error <= kTolerance;
+  fprintf(stdout, "instances: max error %g over %d instances: %s\n",
+      max_error, num_frames, passed ? "OK" : "FAILED");
+  return passed;
+}